@@ -9,6 +9,7 @@ VERSION = 0.5.9
 
 QT       += core network
 QT       += xml
+QT       += concurrent
 TEMPLATE = app
 
 # build as a console application
@@ -31,67 +32,9 @@ else {
 DEFINES += APP_NAME=\\\"$${TARGET}\\\" \
     APP_VERSION=\\\"$${VERSION}\\\"
 
-SOURCES += main.cpp \
-    tcp.cpp \
-    udp.cpp \
-    messages.cpp \
-    utils.cpp \
-    pingTimeout.cpp \
-    scene.cpp \
-    dataType.cpp \
-    sync.cpp \
-    receiveMessage.cpp \
-    sendMessage.cpp \
-    serverCommands.cpp \
-    quest.cpp \
-    serialize.cpp \
-    items.cpp \
-    receiveAck.cpp \
-    receiveChatMessage.cpp \
-    mobsParser.cpp \
-    mob.cpp \
-    mobStats.cpp \
-    skill.cpp \
-    skillparser.cpp \
-    animationparser.cpp \
-    animation.cpp \
-    log.cpp \
-    player.cpp \
-    playerSerialization.cpp \
-    sceneEntity.cpp \
-    settings.cpp \
-    app.cpp \
-    appStartStopServer.cpp
+SOURCES += main.cpp
 
-HEADERS  += \
-    build.h \
-    message.h \
-    utils.h \
-    scene.h \
-    dataType.h \
-    sync.h \
-    quest.h \
-    serialize.h \
-    items.h \
-    sendMessage.h \
-    receiveAck.h \
-    receiveChatMessage.h \
-    mobzone.h \
-    sceneEntity.h \
-    mobsParser.h \
-    mob.h \
-    mobsStats.h \
-    packetloss.h \
-    skill.h \
-    skillparser.h \
-    statsComponent.h \
-    animationparser.h \
-    animation.h \
-    log.h \
-    player.h \
-    settings.h \
-    udp.h \
-    app.h
+include(server.pri)
 
 TRANSLATIONS = ../translations/fr.ts \
     ../translations/ru.ts
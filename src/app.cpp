@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "mob.h"
 #include "sync.h"
+#include "serverTick.h"
 #include "quest.h"
 #include "settings.h"
 #include "udp.h"
@@ -22,7 +23,8 @@ App::App(QWidget *parent) :
     ui(new Ui::App),
 #endif
     cmdPeer(new Player()),
-    sync{new Sync()}
+    sync{new Sync()},
+    tick{new ServerTick(sync.get())}
 {
     tcpServer = new QTcpServer(this);
     udpSocket = new QUdpSocket(this);
@@ -33,8 +35,6 @@ App::App(QWidget *parent) :
     cin_notifier = new QSocketNotifier(fileno(stdin), QSocketNotifier::Read, this);
 #endif
 
-    pingTimer = new QTimer(this);
-
     qsrand(QDateTime::currentMSecsSinceEpoch());
     srand(QDateTime::currentMSecsSinceEpoch());
 }
@@ -137,7 +137,6 @@ App::~App()
     delete tcpServer;
     delete tcpReceivedDatas;
     delete udpSocket;
-    delete pingTimer;
     delete cmdPeer;
 
 #ifdef USE_GUI
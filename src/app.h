@@ -36,9 +36,10 @@
 #define CONFIGFILEPATH "data/server.ini"
 #define SERVERSLISTFILEPATH "data/serversList.cfg"
 
-class Mobzone;
+struct Mobzone;
 class Mob;
 class Sync;
+class ServerTick;
 class Player;
 #ifdef USE_GUI
 namespace Ui {class App;}
@@ -131,8 +132,8 @@ private:
     QTcpSocket remoteLoginSock; // Socket to the remote login server, if we use one
     QByteArray* tcpReceivedDatas;
     Player* cmdPeer; // Player selected for the server commands
-    QTimer* pingTimer;
     std::unique_ptr<Sync> sync;
+    std::unique_ptr<ServerTick> tick; // Runs the game server's input, simulation, sync and output
 };
 
 #ifdef USE_CONSOLE
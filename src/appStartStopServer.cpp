@@ -11,13 +11,20 @@
 #include "quest.h"
 #include "player.h"
 #include "mob.h"
+#include "mobzone.h"
 #include "sync.h"
+#include "serverTick.h"
 #include "udp.h"
+#include "netviewIndex.h"
+#include "sceneLoadQueue.h"
+#include "mobAI.h"
+#include "mobRespawn.h"
 #include "utils.h"
 #include <QUdpSocket>
 #include <QSettings>
 #include <QDir>
 #include <QProcess>
+#include <QtAlgorithms>
 
 #if defined _WIN32 || defined WIN32
 #include <windows.h>
@@ -112,7 +119,6 @@ void App::shutdown()
 #endif
     disconnect(udpSocket);
     disconnect(tcpServer, SIGNAL(newConnection()), this, SLOT(tcpConnectClient()));
-    disconnect(pingTimer, SIGNAL(timeout()), this, SLOT(checkPingTimeouts()));
     disconnect(this);
 
     // Shutdown
@@ -138,6 +144,21 @@ void App::loadConfig()
     enableGameServer = config.value("enableGameServer", DEFAULT_ENABLE_GAME_SERVER).toBool();
     enableMultiplayer = config.value("enableMultiplayer", DEFAULT_ENABLE_MULTIPLAYER).toBool();
     syncInterval = config.value("syncInterval", DEFAULT_SYNC_INTERVAL).toInt();
+    tickInterval = config.value("tickInterval", DEFAULT_TICK_INTERVAL).toInt();
+    syncKeepalive = config.value("syncKeepalive", DEFAULT_SYNC_KEEPALIVE).toInt();
+    syncRadius = config.value("syncRadius", DEFAULT_SYNC_RADIUS).toInt();
+    syncHysteresis = config.value("syncHysteresis", DEFAULT_SYNC_HYSTERESIS).toInt();
+    syncNearRadius = config.value("syncNearRadius", DEFAULT_SYNC_NEAR_RADIUS).toInt();
+    syncMidRadius = config.value("syncMidRadius", DEFAULT_SYNC_MID_RADIUS).toInt();
+    syncMidInterval = config.value("syncMidInterval", DEFAULT_SYNC_MID_INTERVAL).toInt();
+    syncFarInterval = config.value("syncFarInterval", DEFAULT_SYNC_FAR_INTERVAL).toInt();
+    maxMoveSpeed = config.value("maxMoveSpeed", DEFAULT_MAX_MOVE_SPEED).toInt();
+    maxScenePlayers = config.value("maxScenePlayers", DEFAULT_MAX_SCENE_PLAYERS).toInt();
+    streamRadius = config.value("streamRadius", DEFAULT_STREAM_RADIUS).toInt();
+    streamBudget = qMax(1, config.value("streamBudget", DEFAULT_STREAM_BUDGET).toInt());
+    maxConcurrentLoads = config.value("maxConcurrentLoads", DEFAULT_MAX_CONCURRENT_LOADS).toInt();
+    loadBandwidth = config.value("loadBandwidth", DEFAULT_LOAD_BANDWIDTH).toInt();
+    mobAiBudget = config.value("mobAiBudget", DEFAULT_MOB_AI_BUDGET).toInt();
     remoteLoginIP = config.value("remoteLoginIP", DEFAULT_REMOTE_LOGIN_IP).toString();
     remoteLoginPort = config.value("remoteLoginPort", DEFAULT_REMOTE_LOGIN_PORT).toInt();
     remoteLoginTimeout = config.value("remoteLoginTimeout", DEFAULT_REMOTE_LOGIN_TIMEOUT).toInt();
@@ -234,6 +255,21 @@ void App::saveConfig()
     config.setValue("enableGameServer", enableGameServer);
     config.setValue("enableMultiplayer", enableMultiplayer);
     config.setValue("syncInterval", syncInterval);
+    config.setValue("tickInterval", tickInterval);
+    config.setValue("syncKeepalive", syncKeepalive);
+    config.setValue("syncRadius", syncRadius);
+    config.setValue("syncHysteresis", syncHysteresis);
+    config.setValue("syncNearRadius", syncNearRadius);
+    config.setValue("syncMidRadius", syncMidRadius);
+    config.setValue("syncMidInterval", syncMidInterval);
+    config.setValue("syncFarInterval", syncFarInterval);
+    config.setValue("maxMoveSpeed", maxMoveSpeed);
+    config.setValue("maxScenePlayers", maxScenePlayers);
+    config.setValue("streamRadius", streamRadius);
+    config.setValue("streamBudget", streamBudget);
+    config.setValue("maxConcurrentLoads", maxConcurrentLoads);
+    config.setValue("loadBandwidth", loadBandwidth);
+    config.setValue("mobAiBudget", mobAiBudget);
     config.setValue("remoteLoginIP", remoteLoginIP);
     config.setValue("remoteLoginPort", remoteLoginPort);
     config.setValue("remoteLoginTimeout", remoteLoginTimeout);
@@ -307,11 +343,8 @@ void App::startGameServer()
         return;
     }
 
-    SceneEntity::lastNetviewId=0;
-    SceneEntity::lastId=0;
-    for (int i=0; i < 65536; i++) {
-        SceneEntity::usedids[i] = false;
-    }
+    SceneEntity::idAllocator.clear();
+    SceneEntity::idAllocator.reserve(0); // The id of the NPCs, never a netviewId
 
     /// Init
     tcpClientsList.clear();
@@ -332,6 +365,7 @@ void App::startGameServer()
         app.stopGameServer();
         return;
     }
+    linkVortexes();
 
     for (int i=0; i<Scene::scenes.size(); i++)
     {
@@ -365,11 +399,13 @@ void App::startGameServer()
             try
             {
                 Quest quest("data/npcs/"+files[i], NULL);
-                for (const Quest& q : Quest::quests)
-                    if (q.id == quest.id)
-                        logError(tr("Error, two quests are using the same id (%1) !").arg(quest.id));
+                if (!quest.npc->reserveNetviewId(quest.npc->netviewId))
+                    logError(tr("Error, two quests are using the same id (%1) !").arg(quest.id));
                 Quest::quests << quest;
                 Quest::npcs << quest.npc;
+                if (Scene* scene = findScene(quest.npc->sceneId))
+                    scene->addNpc(quest.npc);
+                NetviewIndex::addNpc(quest.npc->netviewId, quest.npc);
             }
             catch (QString& error)
             {
@@ -411,6 +447,7 @@ void App::startGameServer()
                 throw error;
             }
         }
+        linkMobzones();
         logMessage(tr("Loaded %1 mobs in %2 zones").arg(Mob::mobs.size()).arg(Mob::mobzones.size()));
     }
     catch (...)
@@ -462,15 +499,9 @@ void App::startGameServer()
         return;
     }
 
-    // Start ping timeout timer
-    pingTimer->start(pingCheckInterval);
-
-    if (enableMultiplayer)
-        sync->startSync(syncInterval);
-
-    // Signals
-    connect(udpSocket, &QUdpSocket::readyRead, &::udpProcessPendingDatagrams);
-    connect(pingTimer, SIGNAL(timeout()), this, SLOT(checkPingTimeouts()));
+    // Start the game loop. It reads the socket, checks ping timeouts and syncs on each tick
+    tick->resetStats();
+    tick->start(tickInterval, syncInterval, pingCheckInterval);
 
     app.gameServerUp = true;
 
@@ -493,16 +524,28 @@ void App::stopGameServer(bool log)
     //logMessage(tr("UDP: Disconnecting all players"));
     disconnectUdpPlayers();
 
-    sync->stopSync();
-    pingTimer->stop();
+    tick->stop();
 
     for (int i=0;i<tcpClientsList.size();i++)
         tcpClientsList[i].first->close();
 
     udpSocket->close();
 
+    SceneLoadQueue::clear();
+    removeSceneInstances();
     Quest::quests.clear();
     Quest::npcs.clear();
+    MobAI::clear();
+    MobRespawn::clear();
+    Skill::activeEffects.clear(); // The players are gone and the mobs are deleted below
+    for (int i=0; i<Scene::scenes.size(); i++)
+        Scene::scenes[i].clearEntities();
+    qDeleteAll(Mob::mobs); // Only the mobs of the original scenes are left, removeSceneInstances deleted the others
+    Mob::mobs.clear();
+    qDeleteAll(Mob::mobzones);
+    Mob::mobzones.clear();
+    NetviewIndex::clear();
+    SceneEntity::idAllocator.clear();
 
     app.gameServerUp = false;
 
@@ -0,0 +1,131 @@
+#include "entityStore.h"
+#include "sceneEntity.h"
+
+EntityHandle EntityStore::add(SceneEntity* entity, quint8 entityFlags, float entityHealth)
+{
+    quint16 slot;
+    if (!freeSlots.isEmpty())
+    {
+        slot = freeSlots.last();
+        freeSlots.removeLast();
+    }
+    else
+    {
+        if (slotIndex.size() > 0xFFFF)
+            return INVALID_ENTITY_HANDLE;
+        slot = slotIndex.size();
+        slotIndex << -1;
+        slotGeneration << 0;
+    }
+
+    EntityHandle handle = slot | ((EntityHandle)slotGeneration[slot] << 16);
+    slotIndex[slot] = x.size();
+    handles << handle;
+    x << entity->pos.x;
+    y << entity->pos.y;
+    z << entity->pos.z;
+    rot << entity->rot;
+    health << entityHealth;
+    flags << entityFlags;
+    entities << entity;
+    return handle;
+}
+
+void EntityStore::remove(EntityHandle handle)
+{
+    int index = indexOf(handle);
+    if (index < 0)
+        return;
+
+    // Move the last entry in the hole
+    int last = x.size()-1;
+    if (index != last)
+    {
+        x[index] = x[last];
+        y[index] = y[last];
+        z[index] = z[last];
+        rot[index] = rot[last];
+        health[index] = health[last];
+        flags[index] = flags[last];
+        entities[index] = entities[last];
+        handles[index] = handles[last];
+        slotIndex[handles[index] & 0xFFFF] = index;
+    }
+    x.removeLast();
+    y.removeLast();
+    z.removeLast();
+    rot.removeLast();
+    health.removeLast();
+    flags.removeLast();
+    entities.removeLast();
+    handles.removeLast();
+
+    quint16 slot = handle & 0xFFFF;
+    slotIndex[slot] = -1;
+    slotGeneration[slot]++;
+    freeSlots << slot;
+}
+
+int EntityStore::indexOf(EntityHandle handle) const
+{
+    quint16 slot = handle & 0xFFFF;
+    if (handle == INVALID_ENTITY_HANDLE || slot >= slotIndex.size()
+            || slotGeneration[slot] != (handle >> 16))
+        return -1;
+    return slotIndex[slot];
+}
+
+void EntityStore::setTransform(EntityHandle handle, const UVector& pos, const UQuaternion& entityRot)
+{
+    int index = indexOf(handle);
+    if (index < 0)
+        return;
+    x[index] = pos.x;
+    y[index] = pos.y;
+    z[index] = pos.z;
+    rot[index] = entityRot;
+}
+
+void EntityStore::setHealth(EntityHandle handle, float entityHealth)
+{
+    int index = indexOf(handle);
+    if (index >= 0)
+        health[index] = entityHealth;
+}
+
+void EntityStore::setFlag(EntityHandle handle, Flag flag, bool set)
+{
+    int index = indexOf(handle);
+    if (index < 0)
+        return;
+    if (set)
+        flags[index] |= flag;
+    else
+        flags[index] &= ~flag;
+}
+
+void EntityStore::clear()
+{
+    // Free every slot, the old handles must not match the next entities
+    for (int i=0; i<slotIndex.size(); i++)
+    {
+        if (slotIndex[i] < 0)
+            continue;
+        slotIndex[i] = -1;
+        slotGeneration[i]++;
+        freeSlots << i;
+    }
+    x.clear();
+    y.clear();
+    z.clear();
+    rot.clear();
+    health.clear();
+    flags.clear();
+    entities.clear();
+    handles.clear();
+}
+
+int EntityStore::size() const
+{
+    return x.size();
+}
@@ -0,0 +1,53 @@
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include <QVector>
+#include "dataType.h"
+
+struct SceneEntity;
+
+typedef quint32 EntityHandle; // Slot in the low 16 bits, generation of the slot in the high 16 bits
+#define INVALID_ENTITY_HANDLE 0xFFFFFFFF
+
+/// Hot state of the entities of a scene (transform, health, flags), as structure of arrays.
+/// The arrays stay dense: removing an entity moves the last one in its place,
+/// so the tick systems can iterate them without touching the entities themselves.
+/// A handle stays valid as long as its entity is in the store, even when it moves in the arrays.
+/// The entities write through it when they change (see SceneEntity::markSyncDirty and storeHealth).
+class EntityStore
+{
+public:
+    enum Flag : quint8
+    {
+        PlayerEntity = 1,
+        NpcEntity = 2,
+        MobEntity = 4,
+        Dead = 8
+    };
+
+public:
+    EntityHandle add(SceneEntity* entity, quint8 flags, float health);
+    void remove(EntityHandle handle); ///< Does nothing if the handle is stale
+    int indexOf(EntityHandle handle) const; ///< Index in the arrays, -1 if the handle is stale
+    void setTransform(EntityHandle handle, const UVector& pos, const UQuaternion& rot);
+    void setHealth(EntityHandle handle, float health);
+    void setFlag(EntityHandle handle, Flag flag, bool set);
+    void clear();
+    int size() const;
+
+public:
+    // Dense arrays, one entry per entity, all the same size. Don't write to them directly
+    QVector<float> x, y, z;
+    QVector<UQuaternion> rot;
+    QVector<float> health;
+    QVector<quint8> flags;
+    QVector<SceneEntity*> entities;
+
+private:
+    QVector<EntityHandle> handles; // Handle of each entry of the arrays
+    QVector<int> slotIndex; // Index in the arrays of each slot, -1 if the slot is free
+    QVector<quint16> slotGeneration; // Changes every time the slot is freed, so old handles don't match
+    QVector<quint16> freeSlots;
+};
+
+#endif // ENTITYSTORE_H
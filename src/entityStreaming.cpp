@@ -0,0 +1,138 @@
+#include "entityStreaming.h"
+#include "scene.h"
+#include "player.h"
+#include "mob.h"
+#include "message.h"
+#include "settings.h"
+#include <algorithm>
+
+QVector<QPair<float, int>> EntityStreaming::pending;
+MessageBatch EntityStreaming::batch;
+QVector<QPair<quint64, int>> EntityStreaming::cells;
+QSet<quint16> EntityStreaming::near;
+QVector<quint16> EntityStreaming::leaving;
+
+bool EntityStreaming::isEnabled()
+{
+    return Settings::streamRadius > 0;
+}
+
+bool EntityStreaming::knows(const Player* player, quint16 netviewId)
+{
+    return !isEnabled() || player->knownEntities.contains(netviewId);
+}
+
+void EntityStreaming::update()
+{
+    if (!isEnabled())
+        return;
+
+    float enterRadius = Settings::streamRadius;
+    float leaveRadius = enterRadius * (100 + Settings::syncHysteresis) / 100;
+    for (int i=0; i<Scene::scenes.size(); i++)
+    {
+        Scene& scene = Scene::scenes[i];
+        if (scene.players.isEmpty())
+            continue;
+        indexScene(scene, leaveRadius);
+        for (Player* player : scene.players)
+            if (player->inGame >= 2) // The client finished loading the scene
+                updatePlayer(scene, player, enterRadius*enterRadius, leaveRadius*leaveRadius, leaveRadius);
+    }
+}
+
+void EntityStreaming::indexScene(const Scene& scene, float cellSize)
+{
+    const EntityStore& store = scene.entities;
+    cells.clear();
+    for (int i=0; i<store.size(); i++)
+        cells << qMakePair(SpatialGrid::key(SpatialGrid::cellCoord(store.x[i], cellSize),
+                                            SpatialGrid::cellCoord(store.z[i], cellSize)), i);
+    std::sort(cells.begin(), cells.end(),
+              [](const QPair<quint64, int>& a, const QPair<quint64, int>& b){return a.first < b.first;});
+}
+
+void EntityStreaming::updatePlayer(Scene& scene, Player* player, float enter2, float leave2, float cellSize)
+{
+    const EntityStore& store = scene.entities;
+    float x = player->pony.pos.x;
+    float z = player->pony.pos.z;
+    pending.clear();
+    near.clear();
+
+    // Everything within leaveRadius is in the 3x3 cells around us
+    int cx = SpatialGrid::cellCoord(x, cellSize), cz = SpatialGrid::cellCoord(z, cellSize);
+    for (int gx=cx-1; gx<=cx+1; gx++)
+    {
+        for (int gz=cz-1; gz<=cz+1; gz++)
+        {
+            quint64 key = SpatialGrid::key(gx, gz);
+            auto it = std::lower_bound(cells.begin(), cells.end(), key,
+                                       [](const QPair<quint64, int>& cell, quint64 key){return cell.first < key;});
+            for (; it != cells.end() && it->first == key; ++it)
+            {
+                int i = it->second;
+                quint16 netviewId = store.entities[i]->netviewId;
+                if (netviewId == player->pony.netviewId)
+                    continue;
+                float dx = store.x[i] - x;
+                float dz = store.z[i] - z;
+                float dist2 = dx*dx + dz*dz;
+                if (dist2 > leave2)
+                    continue;
+                near.insert(netviewId);
+                bool dead = store.flags[i] & EntityStore::Dead;
+                if (!dead && dist2 <= enter2 && !player->knownEntities.contains(netviewId))
+                    pending << qMakePair(dist2, i);
+            }
+        }
+    }
+
+    // The known entities we didn't find are past leaveRadius
+    leaving.clear();
+    for (quint16 netviewId : player->knownEntities)
+        if (netviewId != player->pony.netviewId && !near.contains(netviewId))
+            leaving << netviewId;
+    for (quint16 netviewId : leaving)
+    {
+        sendNetviewRemove(player, netviewId);
+        player->knownEntities.remove(netviewId);
+    }
+
+    // Nearest first, the others wait for the next update
+    int count = qMin(pending.size(), Settings::streamBudget);
+    std::partial_sort(pending.begin(), pending.begin()+count, pending.end());
+    batch.clear();
+    for (int i=0; i<count; i++)
+    {
+        int index = pending[i].second;
+        SceneEntity* entity = store.entities[index];
+        QString key = (store.flags[index] & EntityStore::MobEntity) ? entity->modelName : QString("PlayerBase");
+        batch.append(MsgUserReliableOrdered6, netviewInstantiateData(key, entity->netviewId, entity->id, entity->pos, entity->rot));
+        player->knownEntities.insert(entity->netviewId);
+    }
+    if (!batch.isEmpty()) // In as few grouped messages as possible
+        sendMessageBatch(player, batch);
+}
+
+void EntityStreaming::sceneLoaded(Player* player)
+{
+    player->knownEntities.clear();
+    player->knownEntities.insert(player->pony.netviewId);
+    sendNetviewInstantiate(&player->pony, player);
+}
+
+void EntityStreaming::forget(Scene* scene, quint16 netviewId, quint8 reasonCode)
+{
+    for (Player* player : scene->players)
+    {
+        if (player->pony.netviewId == netviewId)
+            continue;
+        if (isEnabled() && !player->knownEntities.remove(netviewId))
+            continue;
+        if (reasonCode == NetviewRemoveReasonDefault)
+            sendNetviewRemove(player, netviewId);
+        else
+            sendNetviewRemove(player, netviewId, reasonCode);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef ENTITYSTREAMING_H
+#define ENTITYSTREAMING_H
+
+#include <QVector>
+#include <QPair>
+#include <QSet>
+#include "messageBatch.h"
+
+class Scene;
+class Player;
+
+/// Instantiates the entities of a scene on the clients by distance, instead of all of them when the scene loads.
+/// Each player knows the netviews his client has instantiated (Player::knownEntities).
+/// The entities that come within Settings::streamRadius are instantiated, nearest first and at most
+/// Settings::streamBudget per player per update, and removed once they're past the radius plus the hysteresis.
+/// With a streamRadius of 0 the whole scene is instantiated at once, like before.
+class EntityStreaming
+{
+public:
+    static bool isEnabled();
+    static void update(); ///< Streams the entities in and out for every loaded player. Main thread only
+    static bool knows(const Player* player, quint16 netviewId); ///< Whether the client instantiated this netview, always true without streaming
+    static void sceneLoaded(Player* player); ///< The client of the player loaded his scene, he only knows his own pony
+    /// Removes the netview from the clients of the scene that know it.
+    /// With a reasonCode other than NetviewRemoveReasonDefault (0), the clients are told why
+    static void forget(Scene* scene, quint16 netviewId, quint8 reasonCode = 0);
+
+private:
+    static void indexScene(const Scene& scene, float cellSize); ///< Fills cells with the entities of the scene's store
+    static void updatePlayer(Scene& scene, Player* player, float enter2, float leave2, float cellSize);
+
+private:
+    static QVector<QPair<float, int>> pending; // Entities to instantiate for the current player, distance² and index in the store
+    static MessageBatch batch; // Instantiates for the current player, sent together
+    static QVector<QPair<quint64, int>> cells; // Entities of the current scene sorted by cell (see SpatialGrid::key), and their index in the store
+    static QSet<quint16> near; // Entities within the cells around the current player
+    static QVector<quint16> leaving; // Known entities of the current player that went past leaveRadius
+};
+
+#endif // ENTITYSTREAMING_H
@@ -0,0 +1,83 @@
+#include "idAllocator.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+IdAllocator::IdAllocator()
+{
+    memset(used, 0, sizeof(used));
+    memset(full, 0, sizeof(full));
+    memset(generations, 0, sizeof(generations));
+    nUsed = 0;
+}
+
+int IdAllocator::allocate()
+{
+    for (int i=0; i<ID_WORDS/64; i++)
+    {
+        if (full[i] == ~quint64(0))
+            continue;
+        int word = i*64 + qCountTrailingZeroBits(~full[i]);
+        int id = word*64 + qCountTrailingZeroBits(~used[word]);
+        markUsed(id);
+        return id;
+    }
+    return -1;
+}
+
+bool IdAllocator::reserve(quint16 id)
+{
+    if (isUsed(id))
+        return false;
+    markUsed(id);
+    return true;
+}
+
+void IdAllocator::release(quint16 id)
+{
+    if (!isUsed(id))
+        return;
+    int word = id/64;
+    used[word] &= ~(quint64(1) << (id%64));
+    full[word/64] &= ~(quint64(1) << (word%64));
+    generations[id]++;
+    nUsed--;
+}
+
+bool IdAllocator::isUsed(quint16 id) const
+{
+    return (used[id/64] >> (id%64)) & 1;
+}
+
+quint16 IdAllocator::generation(quint16 id) const
+{
+    return generations[id];
+}
+
+bool IdAllocator::isCurrent(quint16 id, quint16 generation) const
+{
+    return isUsed(id) && generations[id] == generation;
+}
+
+void IdAllocator::clear()
+{
+    for (int i=0; i<ID_COUNT; i++)
+        if (isUsed(i))
+            generations[i]++;
+    memset(used, 0, sizeof(used));
+    memset(full, 0, sizeof(full));
+    nUsed = 0;
+}
+
+int IdAllocator::count() const
+{
+    return nUsed;
+}
+
+void IdAllocator::markUsed(quint16 id)
+{
+    int word = id/64;
+    used[word] |= quint64(1) << (id%64);
+    if (used[word] == ~quint64(0))
+        full[word/64] |= quint64(1) << (word%64);
+    nUsed++;
+}
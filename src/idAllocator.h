@@ -0,0 +1,36 @@
+#ifndef IDALLOCATOR_H
+#define IDALLOCATOR_H
+
+#include <QtGlobal>
+
+#define ID_COUNT 65536
+#define ID_WORDS (ID_COUNT/64)
+
+/// Allocates the 16-bit ids of the entities.
+/// A bitset of the used ids, with a second level marking the full words,
+/// so finding the lowest free id looks at a handful of words instead of the whole range.
+/// Each id has a generation that changes when it's released, to recognize a stale id.
+class IdAllocator
+{
+public:
+    IdAllocator();
+    int allocate(); ///< Takes the lowest free id, -1 if they're all used
+    bool reserve(quint16 id); ///< Takes this id, false if it's already used
+    void release(quint16 id); ///< Frees the id, and gives it a new generation
+    bool isUsed(quint16 id) const;
+    quint16 generation(quint16 id) const; ///< Current generation of the id
+    bool isCurrent(quint16 id, quint16 generation) const; ///< True if the id is used and still has this generation
+    void clear(); ///< Frees every id. The generations are kept, old ids stay stale
+    int count() const; ///< Number of used ids
+
+private:
+    void markUsed(quint16 id);
+
+private:
+    quint64 used[ID_WORDS]; // Bit set if the id is used
+    quint64 full[ID_WORDS/64]; // Bit set if the matching word of used is full
+    quint16 generations[ID_COUNT];
+    int nUsed;
+};
+
+#endif // IDALLOCATOR_H
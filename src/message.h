@@ -6,6 +6,7 @@
 #include <QByteArray>
 #include <QStringList>
 #include "dataType.h"
+#include "scene.h"
 
 enum NetviewRemoveReasonCodes {
     NetviewRemoveReasonDefault = 0,
@@ -52,16 +53,22 @@ class Player;
 class Pony;
 class Mob;
 class Animation;
+class MessageBatch;
 void receiveMessage(Player* player);
 void sendMessage(Player* player, quint8 messageType, QByteArray data=QByteArray());
+void sendMessageBatch(Player* player, const MessageBatch& batch); // Queues every message of the batch, in full grouped messages
+void appendUnreliableMessage(Player* player, QByteArray& datagram, const QByteArray& data);
+void sendDatagram(Player* player, const QByteArray& datagram);
 void sendEntitiesList(Player* player);
 void sendPonySave(Player* player, QByteArray msg);
 void sendPonies(Player* player);
 void sendPonyData(Player* player);
 void sendPonyData(Pony *src, Player* dst);
+QByteArray netviewInstantiateData(const QString& key, quint16 NetviewId, quint16 ViewId, UVector pos, UQuaternion rot); // Payload of an instantiate, to encode it once in a MessageBatch
 void sendNetviewInstantiate(Player* player, QString key, quint16 NetviewId, quint16 ViewId, UVector pos, UQuaternion rot);
 void sendNetviewInstantiate(Player* player);
 void sendNetviewInstantiate(Player* player, Mob* mob);
+void sendNetviewInstantiate(Scene* scene, const QVector<Mob*>& mobs); // Instantiates these mobs for every player of the scene, as one batch
 void sendNetviewInstantiate(Pony *src, Player* dst);
 void sendNetviewRemove(Player* player, quint16 netviewId);
 void sendNetviewRemove(Player* player, quint16 netviewId, quint8 reasonCode);
@@ -83,8 +90,10 @@ void sendInventoryRPC(Player* player);
 void sendSetBitsRPC(Player* player); // Resend how many bits we have to the clients
 void sendSkillsRPC(Player* player, QList<QPair<quint32, quint32> >& skills);
 bool sendLoadSceneRPC(Player* player, QString sceneName);
-bool sendLoadSceneRPC(Player* player, QString sceneName, UVector pos, UQuaternion rot);
-void sendChannelMessage(QString sceneName, qint8 channel, QString message, QString author, quint8 accessLevel);
+bool sendLoadSceneRPC(Player* player, SceneId sceneId);
+bool sendLoadSceneRPC(Player* player, SceneId sceneId, UVector pos, UQuaternion rot); // Picks the instance of the scene, see pickSceneInstance
+bool sendLoadSceneRPC(Player* player, Scene* scene, UVector pos, UQuaternion rot); // Loads this instance, even if it's full
+void sendChannelMessage(SceneId sceneId, qint8 channel, QString message, QString author, quint8 accessLevel);
 void sendChatBroadcast(Player* to, QString message, QString author, quint8 accessLevel);
 void sendChatMessage(Player* to, QString message, QString author, quint8 chatType, quint8 accessLevel);
 void sendMove(Player* player, float x, float y, float z);
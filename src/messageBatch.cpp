@@ -0,0 +1,38 @@
+#include "messageBatch.h"
+
+void MessageBatch::append(quint8 messageType, const QByteArray& data)
+{
+    int start = buffer.size();
+    offsets << start;
+    buffer.resize(start+5);
+    buffer[start] = messageType;
+    // Sequence, set when sending
+    buffer[start+1] = 0;
+    buffer[start+2] = 0;
+    // Payload size
+    buffer[start+3] = (quint8)((8*(data.size()))&0xFF);
+    buffer[start+4] = (quint8)(((8*(data.size())) >> 8)&0xFF);
+    buffer += data;
+}
+
+void MessageBatch::clear()
+{
+    buffer.clear();
+    offsets.clear();
+}
+
+bool MessageBatch::isEmpty() const
+{
+    return offsets.isEmpty();
+}
+
+int MessageBatch::count() const
+{
+    return offsets.size();
+}
+
+int MessageBatch::messageSize(int index) const
+{
+    int end = index+1 < offsets.size() ? offsets[index+1] : buffer.size();
+    return end - offsets[index];
+}
@@ -0,0 +1,23 @@
+#ifndef MESSAGEBATCH_H
+#define MESSAGEBATCH_H
+
+#include <QByteArray>
+#include <QVector>
+
+/// Reliable messages encoded once, then sent as they are to any number of players.
+/// Only the sequence numbers differ between players, sendMessageBatch fills them in.
+class MessageBatch
+{
+public:
+    void append(quint8 messageType, const QByteArray& data); ///< Adds a reliable message, with its header
+    void clear();
+    bool isEmpty() const;
+    int count() const; ///< Number of messages
+    int messageSize(int index) const; ///< Size of a message with its header, in bytes
+
+public:
+    QByteArray buffer; // The messages one after the other, with a 0 sequence number
+    QVector<int> offsets; // Start of each message in buffer
+};
+
+#endif // MESSAGEBATCH_H
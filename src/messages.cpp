@@ -7,12 +7,15 @@
 #include "quest.h"
 #include "log.h"
 #include "scene.h"
+#include "rpc.h"
+#include "utils.h"
+#include "netviewIndex.h"
+#include "entityStreaming.h"
+#include "messageBatch.h"
+#include "settings.h"
 
 #define DEBUG_LOG false
 
-// File-global game-entering mutex (to prevent multiple instantiates)
-static QMutex levelLoadMutex;
-
 void sendPonies(Player* player)
 {
     // The full request is like a normal sendPonies but with all the serialized ponies at the end
@@ -35,12 +38,42 @@ void sendPonies(Player* player)
     sendMessage(player, MsgUserReliableOrdered4, data);
 }
 
+QByteArray netviewInstantiateData(const QString& key, quint16 NetviewId, quint16 ViewId, UVector pos, UQuaternion rot)
+{
+    QByteArray data(1,1);
+    data += stringToData(key);
+    Rpc::append<InstantiateLayout>(data, NetviewId, ViewId, pos, rot);
+    return data;
+}
+
+// Instantiates of everything in the scene, encoded once for all the players that finish loading it during the same tick
+static const MessageBatch& sceneEntityList(Scene* scene)
+{
+    float now = timestampNow();
+    if (!scene->entityList.isEmpty() && scene->entityListVersion == scene->entitiesVersion
+            && now - scene->entityListTime < Settings::tickInterval / 1000.0)
+        return scene->entityList;
+
+    MessageBatch& list = scene->entityList;
+    list.clear();
+    for (Player* player : scene->players)
+        list.append(MsgUserReliableOrdered6, netviewInstantiateData("PlayerBase", player->pony.netviewId, player->pony.id,
+                                                                    player->pony.pos, player->pony.rot));
+    for (Pony* npc : scene->npcs)
+        list.append(MsgUserReliableOrdered6, netviewInstantiateData("PlayerBase", npc->netviewId, npc->id, npc->pos, npc->rot));
+    for (Mob* mob : scene->mobs)
+        if (!mob->dead)
+            list.append(MsgUserReliableOrdered6, netviewInstantiateData(mob->modelName, mob->netviewId, mob->id, mob->pos, mob->rot));
+    scene->entityListVersion = scene->entitiesVersion;
+    scene->entityListTime = now;
+    return list;
+}
+
 void sendEntitiesList(Player *player)
 {
-    levelLoadMutex.lock(); // Protect player->inGame
+    // player->inGame and the scene lists only change on the main thread, the sync workers just read them
     if (player->inGame == 0) // Not yet in game, send player's ponies list (Characters scene)
     {
-        levelLoadMutex.unlock();
 #if DEBUG_LOG
         app.logMessage("UDP: Sending ponies list");
 #endif
@@ -49,40 +82,25 @@ void sendEntitiesList(Player *player)
     }
     else if (player->inGame > 1) // Not supposed to happen, let's do it anyway
     {
-        //levelLoadMutex.unlock();
         logMessage(QObject::tr("UDP: Entities list already sent to %1, resending anyway").arg(player->pony.netviewId));
         //return;
     }
     else // Loading finished, sending entities list
     logMessage(QObject::tr("UDP: Sending entities list to %1 (%2/%3)").arg(player->pony.netviewId).arg(player->name).arg(player->pony.name));
-    Scene* scene = findScene(player->pony.sceneName); // Spawn all the players on the client
-    for (int i=0; i<scene->players.size(); i++)
-        sendNetviewInstantiate(&scene->players[i]->pony, player);
-
-    // Send npcs
-    for (int i=0; i<Quest::npcs.size(); i++)
-        if (Quest::npcs[i]->sceneName.toLower() == player->pony.sceneName.toLower())
-        {
-#if DEBUG_LOG
-            logMessage("UDP: Sending NPC "+Quest::npcs[i]->name);
-#endif
-            sendNetviewInstantiate(Quest::npcs[i], player);
-        }
-
-    // Send mobs
-    for (int i=0; i<Mob::mobs.size(); i++)
-        if (Mob::mobs[i]->sceneName.toLower() == player->pony.sceneName.toLower())
-        {
-#if DEBUG_LOG
-            logMessage("UDP: Sending mob "+Mob::mobs[i]->modelName);
-#endif
-            sendNetviewInstantiate(player, Mob::mobs[i]);
-        }
+    Scene* scene = player->pony.scene; // Spawn all the players on the client
+    if (!scene)
+    {
+        logError(QObject::tr("UDP: Can't find the scene of %1 for the entities list, aborting").arg(player->pony.netviewId));
+        return;
+    }
+    if (EntityStreaming::isEnabled()) // Only our pony for now, the rest comes by distance
+        EntityStreaming::sceneLoaded(player);
+    else // Players, NPCs and mobs, packed in as few grouped messages as possible
+        sendMessageBatch(player, sceneEntityList(scene));
 
     player->inGame = 2;
-    levelLoadMutex.unlock();
 
-    // Send stats of the client's pony
+    // Send stats of the client's pony, they fill the last grouped message of the list
     sendSetMaxStatRPC(player, 0, 100);
     sendSetStatRPC(player, 0, 100);
     sendSetMaxStatRPC(player, 1, 100);
@@ -98,15 +116,12 @@ void sendPonySave(Player *player, QByteArray msg)
     }
 
     quint16 netviewId = (quint8)msg[6] + ((quint16)(quint8)msg[7]<<8);
-    Player* refresh = Player::findPlayer(Player::udpPlayers, netviewId); // Find players
+    const NetviewRef& target = NetviewIndex::find(netviewId);
 
     // If we find a matching NPC, send him and exits
-    Pony* npc = NULL;
-    for (int i=0; i<Quest::npcs.size(); i++)
-        if (Quest::npcs[i]->netviewId == netviewId)
-            npc = Quest::npcs[i];
-    if (npc != NULL)
+    if (target.type == NetviewRef::Npc)
     {
+        Pony* npc = target.npc;
 #if DEBUG_LOG
         logMessage("UDP: Sending ponyData and worn items for NPC "+npc->name);
 #endif
@@ -119,12 +134,9 @@ void sendPonySave(Player *player, QByteArray msg)
     }
 
     // If we find a matching mob, send him and exits
-    Mob* mob = nullptr;
-    for (int i=0; i<Mob::mobs.size(); i++)
-        if (Mob::mobs[i]->netviewId == netviewId)
-            mob = Mob::mobs[i];
-    if (mob != nullptr)
+    if (target.type == NetviewRef::MobEntity)
     {
+        Mob* mob = target.mob;
         //app.logMessage("UDP: mob ponyData requested");
         // We should probably send the mob's stats here
         sendSetMaxStatRPC(player, mob->netviewId, 1, defaultMaxHealth[(unsigned)mob->type]);
@@ -188,10 +200,11 @@ void sendPonySave(Player *player, QByteArray msg)
         sendSetMaxStatRPC(player, 1, 100);
         sendSetStatRPC(player, 1, 100);
 
-        refresh->inGame = 3;
+        player->inGame = 3;
     }
-    else if (!refresh->IP.isEmpty())
+    else if (target.type == NetviewRef::PlayerPony)
     {
+        Player* refresh = target.player;
 #if DEBUG_LOG
         app.logMessage(QString("UDP: Sending pony save for ")+QString().setNum(refresh->pony.netviewId)
                        +" to "+QString().setNum(player->pony.netviewId));
@@ -217,17 +230,7 @@ void sendPonySave(Player *player, QByteArray msg)
 
 void sendNetviewInstantiate(Player *player, QString key, quint16 NetviewId, quint16 ViewId, UVector pos, UQuaternion rot)
 {
-    QByteArray data(1,1);
-    data += stringToData(key);
-    QByteArray data2(4,0);
-    data2[0]=(quint8)(NetviewId&0xFF);
-    data2[1]=(quint8)((NetviewId>>8)&0xFF);
-    data2[2]=(quint8)(ViewId&0xFF);
-    data2[3]=(quint8)((ViewId>>8)&0xFF);
-    data += data2;
-    data += vectorToData(pos);
-    data += quaternionToData(rot);
-    sendMessage(player, MsgUserReliableOrdered6, data);
+    sendMessage(player, MsgUserReliableOrdered6, netviewInstantiateData(key, NetviewId, ViewId, pos, rot));
 }
 
 void sendNetviewInstantiate(Player* player, Mob* mob)
@@ -235,22 +238,25 @@ void sendNetviewInstantiate(Player* player, Mob* mob)
     sendNetviewInstantiate(player, mob->modelName, mob->netviewId, mob->id, mob->pos, mob->rot);
 }
 
+void sendNetviewInstantiate(Scene* scene, const QVector<Mob*>& mobs)
+{
+    if (scene->players.isEmpty())
+        return;
+    static MessageBatch batch; // Only used from the main thread
+    batch.clear();
+    for (Mob* mob : mobs)
+        batch.append(MsgUserReliableOrdered6, netviewInstantiateData(mob->modelName, mob->netviewId, mob->id, mob->pos, mob->rot));
+    for (Player* player : scene->players)
+        sendMessageBatch(player, batch);
+}
+
 void sendNetviewInstantiate(Player *player)
 {
 #if DEBUG_LOG
     app.logMessage("UDP: Send instantiate for/to "+QString().setNum(player->pony.netviewId));
 #endif
-    QByteArray data(1,1);
-    data += stringToData("PlayerBase");
-    QByteArray data2(4,0);
-    data2[0]=(quint8)(player->pony.netviewId&0xFF);
-    data2[1]=(quint8)((player->pony.netviewId>>8)&0xFF);
-    data2[2]=(quint8)(player->pony.id&0xFF);
-    data2[3]=(quint8)((player->pony.id>>8)&0xFF);
-    data += data2;
-    data += vectorToData(player->pony.pos);
-    data += quaternionToData(player->pony.rot);
-    sendMessage(player, MsgUserReliableOrdered6, data);
+    sendNetviewInstantiate(player, "PlayerBase", player->pony.netviewId, player->pony.id,
+                           player->pony.pos, player->pony.rot);
 
     logMessage(QObject::tr("Instantiate at %1 %2 %3").arg(player->pony.pos.x)
                     .arg(player->pony.pos.y).arg(player->pony.pos.z));
@@ -262,17 +268,7 @@ void sendNetviewInstantiate(Pony *src, Player *dst)
     app.logMessage("UDP: Send instantiate for "+QString().setNum(src->netviewId)
                    +" to "+QString().setNum(dst->pony.netviewId));
 #endif
-    QByteArray data(1,1);
-    data += stringToData("PlayerBase");
-    QByteArray data2(4,0);
-    data2[0]=(quint8)(src->netviewId&0xFF);
-    data2[1]=(quint8)((src->netviewId>>8)&0xFF);
-    data2[2]=(quint8)(src->id&0xFF);
-    data2[3]=(quint8)((src->id>>8)&0xFF);
-    data += data2;
-    data += vectorToData(src->pos);
-    data += quaternionToData(src->rot);
-    sendMessage(dst, MsgUserReliableOrdered6, data);
+    sendNetviewInstantiate(dst, "PlayerBase", src->netviewId, src->id, src->pos, src->rot);
 
    //app.logMessage(QString("Instantiate at ")+QString().setNum(rSrc.pony.pos.x)+" "
    //                +QString().setNum(rSrc.pony.pos.y)+" "
@@ -283,10 +279,7 @@ void sendNetviewRemove(Player *player, quint16 netviewId)
 {
     //logMessage(QObject::tr("UDP: Removing netview %1 to %2").arg(netviewId).arg(player->pony.netviewId));
 
-    QByteArray data(3,2);
-    data[1] = (quint8)(netviewId&0xFF);
-    data[2] = (quint8)((netviewId>>8)&0xFF);
-    sendMessage(player, MsgUserReliableOrdered6, data);
+    sendMessage(player, NetviewRemoveRPC::channel, NetviewRemoveRPC::encode(netviewId));
 }
 
 void sendNetviewRemove(Player* player, quint16 netviewId, quint8 reasonCode)
@@ -294,31 +287,17 @@ void sendNetviewRemove(Player* player, quint16 netviewId, quint8 reasonCode)
     //app.logMessage(QObject::tr("UDP: Removing netview %1 to %2, reason code %3").arg(netviewId)
     //               .arg(player->pony.netviewId).arg(reasonCode));
 
-    QByteArray data(4,2);
-    data[1] = (quint8)(netviewId&0xFF);
-    data[2] = (quint8)((netviewId>>8)&0xFF);
-    data[3] = reasonCode;
-    sendMessage(player, MsgUserReliableOrdered6, data);
+    sendMessage(player, NetviewRemoveReasonRPC::channel, NetviewRemoveReasonRPC::encode(netviewId, reasonCode));
 }
 
 void sendSetStatRPC(Player* player, quint16 netviewId, quint8 statId, float value)
 {
-    QByteArray data(4,50);
-    data[0] = (quint8)(netviewId&0xFF);
-    data[1] = (quint8)((netviewId>>8)&0xFF);
-    data[3] = statId;
-    data += floatToData(value);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendMessage(player, SetStatRPC::channel, SetStatRPC::encode(netviewId, statId, value));
 }
 
 void sendSetMaxStatRPC(Player* player, quint16 netviewId, quint8 statId, float value)
 {
-    QByteArray data(4,51);
-    data[0] = (quint8)(netviewId&0xFF);
-    data[1] = (quint8)((netviewId>>8)&0xFF);
-    data[3] = statId;
-    data += floatToData(value);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendMessage(player, SetMaxStatRPC::channel, SetMaxStatRPC::encode(netviewId, statId, value));
 }
 
 void sendSetStatRPC(Player *player, quint8 statId, float value)
@@ -333,22 +312,12 @@ void sendSetMaxStatRPC(Player* player, quint8 statId, float value)
 
 void sendSetStatRPC(Player* affected, Player* dest, quint8 statId, float value)
 {
-    QByteArray data(4,50);
-    data[0] = (quint8)(affected->pony.netviewId&0xFF);
-    data[1] = (quint8)((affected->pony.netviewId>>8)&0xFF);
-    data[3] = statId;
-    data += floatToData(value);
-    sendMessage(dest, MsgUserReliableOrdered18, data);
+    sendSetStatRPC(dest, affected->pony.netviewId, statId, value);
 }
 
 void sendSetMaxStatRPC(Player* affected, Player* dest, quint8 statId, float value)
 {
-    QByteArray data(4,51);
-    data[0] = (quint8)(affected->pony.netviewId&0xFF);
-    data[1] = (quint8)((affected->pony.netviewId>>8)&0xFF);
-    data[3] = statId;
-    data += floatToData(value);
-    sendMessage(dest, MsgUserReliableOrdered18, data);
+    sendSetMaxStatRPC(dest, affected->pony.netviewId, statId, value);
 }
 
 void sendWornRPC(Player* player)
@@ -435,11 +404,7 @@ void sendInventoryRPC(Player *player, QList<InventoryItem>& inv, QList<WearableI
 
 void sendSetBitsRPC(Player* player)
 {
-    QByteArray data(3, 0x10);
-    data[0] = (quint8)(player->pony.netviewId & 0xFF);
-    data[1] = (quint8)((player->pony.netviewId>>8) & 0xFF);
-    data += uint32ToData(player->pony.nBits);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendMessage(player, SetBitsRPC::channel, SetBitsRPC::encode(player->pony.netviewId, player->pony.nBits));
 }
 
 void sendSkillsRPC(Player* player, QList<QPair<quint32, quint32> > &skills)
@@ -491,64 +456,88 @@ void sendPonyData(Pony *src, Player *dst)
 
 bool sendLoadSceneRPC(Player* player, QString sceneName) // Loads a scene and send to the default spawn
 {
-    Vortex vortex = findVortex(sceneName, 0);
+    SceneId sceneId = findSceneId(sceneName);
+    if (sceneId == INVALID_SCENE_ID)
+    {
+        logError(QObject::tr("UDP: Scene %1 not in vortex DB. Aborting scene load.").arg(sceneName));
+        return false;
+    }
+    return sendLoadSceneRPC(player, sceneId);
+}
+
+bool sendLoadSceneRPC(Player* player, SceneId sceneId) // Loads a scene and send to the default spawn
+{
+    const Vortex& vortex = findVortex(sceneId, 0);
     if (vortex.destName.isEmpty())
     {
         logError(QObject::tr("UDP: Scene not in vortex DB. Aborting scene load."));
         return false;
     }
-    return sendLoadSceneRPC(player, sceneName, vortex.destPos, vortex.destRot);
+    return sendLoadSceneRPC(player, sceneId, vortex.destPos, vortex.destRot);
 }
 
-bool sendLoadSceneRPC(Player* player, QString sceneName, UVector pos, UQuaternion rot) // Loads a scene and send to the given pos
+bool sendLoadSceneRPC(Player* player, SceneId sceneId, UVector pos, UQuaternion rot) // Loads a scene and send to the given pos
 {
-    logMessage(QString(QString("UDP: Loading scene \"%1\" to %2 (%3/%4)\r\n\tat pos %5 %6 %7 rot %8 %9 %10 %11")
-                           .arg(sceneName).arg(player->pony.netviewId).arg(player->name).arg(player->pony.name)
-                           .arg(pos.x).arg(pos.y).arg(pos.z)
-                           .arg(rot.x).arg(rot.y).arg(rot.z).arg(rot.w)));
-
-    Scene* scene = findScene(sceneName);
-    Scene* oldScene = findScene(player->pony.sceneName);
-    if (scene->name.isEmpty() || oldScene->name.isEmpty())
+    Scene* scene = pickSceneInstance(sceneId, player);
+    if (!scene)
     {
-        logError(QObject::tr("UDP: Can't find scene %1, aborting").arg(sceneName));
+        logError(QObject::tr("UDP: Can't find scene %1, aborting").arg(sceneId));
         return false;
     }
+    return sendLoadSceneRPC(player, scene, pos, rot);
+}
+
+bool sendLoadSceneRPC(Player* player, Scene* scene, UVector pos, UQuaternion rot) // Loads this instance of a scene and send to the given pos
+{
+    Scene* oldScene = player->pony.scene; // nullptr if we're not spawned yet
+
+    logMessage(QString(QString("UDP: Loading scene \"%1\" to %2 (%3/%4)\r\n\tat pos %5 %6 %7 rot %8 %9 %10 %11")
+                           .arg(scene->displayName()).arg(player->pony.netviewId).arg(player->name).arg(player->pony.name)
+                           .arg(pos.x).arg(pos.y).arg(pos.z)
+                           .arg(rot.x).arg(rot.y).arg(rot.z).arg(rot.w)));
 
-    // Update scene players
-    //app.logMessage("sendLoadSceneRPC pos: locking");
-    levelLoadMutex.lock();
+    // Update scene players. This moves the player across two scenes, so it only runs on the main thread
+    // between the scene jobs (see ServerTick::post), never while a worker owns those scenes
     player->inGame = 1;
     player->pony.pos = pos;
     player->pony.rot = rot;
-    player->pony.sceneName = sceneName.toLower();
+    player->pony.sceneId = scene->id;
+    player->pony.markSyncDirty();
+    player->pony.history.clear();
     player->lastValidReceivedAnimation.clear(); // Changing scenes resets animations
-    Player::removePlayer(oldScene->players, player->IP, player->port);
-    // Send remove RPC to the other players of the old scene
-    for (int i=0; i<oldScene->players.size(); i++)
-        sendNetviewRemove(oldScene->players[i], player->pony.netviewId);
-    // Send instantiate to the players of the new scene
-    for (int i=0; i < scene->players.size(); i++)
+    player->lastSyncSent.clear(); // The new scene's entities are all new to the client
+    player->syncInterest.clear();
+    player->knownEntities.clear();
+    player->lastValidPos = pos; // We're moving the player, the validation must not pull it back
+    player->lastValidTime = timestampNow();
+    if (oldScene)
     {
-        if (scene->players[i]->inGame >= 2)
-            sendNetviewInstantiate(&player->pony, scene->players[i]);
+        oldScene->removePlayer(player);
+        EntityStreaming::forget(oldScene, player->pony.netviewId); // Remove us from the other players of the old scene
     }
-    scene->players << player;
+    // Send instantiate to the players of the new scene, or let the streaming do it when they're close
+    if (!EntityStreaming::isEnabled())
+    {
+        for (int i=0; i < scene->players.size(); i++)
+        {
+            if (scene->players[i]->inGame >= 2)
+                sendNetviewInstantiate(&player->pony, scene->players[i]);
+        }
+    }
+    scene->addPlayer(player);
 
     QByteArray data(1,5);
-    data += stringToData(sceneName.toLower());
+    data += stringToData(scene->name);
     sendMessage(player,MsgUserReliableOrdered6,data); // Sends a 48
-    //app.logMessage("sendLoadSceneRPC pos: unlocking");
-    levelLoadMutex.unlock();
     return true;
 }
 
-void sendChannelMessage(QString sceneName, qint8 channel, QString message, QString author, quint8 accessLevel)
+void sendChannelMessage(SceneId sceneId, qint8 channel, QString message, QString author, quint8 accessLevel)
 {
    if (channel==ChatLocal)
    {
-       Scene* scene = findScene(sceneName);
-       if (scene->name.isEmpty())
+       Scene* scene = findScene(sceneId);
+       if (!scene)
            logError(QObject::tr("UDP: Can't find the scene for chat message, aborting"));
        else
        {
@@ -586,38 +575,26 @@ void sendChatMessage(Player* to, QString message, QString author, quint8 chatTyp
 {
     if (accessLevel < 1 || accessLevel > 4) // valid access levels are 1-4
         accessLevel = 1;
-    QByteArray idAndAccess(5,0);
-    idAndAccess[0] = (quint8)(to->pony.netviewId&0xFF);
-    idAndAccess[1] = (quint8)((to->pony.netviewId << 8)&0xFF);
-    idAndAccess[2] = (quint8)((to->pony.id&0xFF));
-    idAndAccess[3] = (quint8)((to->pony.id << 8)&0xFF);
-    idAndAccess[4] = (quint8)(accessLevel&0xFF); // Access level
-    //idAndAccess[4] = 0x0; // Access level
     QByteArray data(2,0);
     data[0] = 0xf; // RPC ID
     data[1] = chatType;
     data += stringToData(author);
     data += stringToData(message);
-    data += idAndAccess;
+    Rpc::append<ChatSenderLayout>(data, to->pony.netviewId, to->pony.id, accessLevel);
     sendMessage(to,MsgUserReliableOrdered4,data); // Sends a 46
 }
 
 void sendMove(Player* player, float x, float y, float z)
 {
-    QByteArray data(1,0);
-    data[0] = 0xce; // Request number
-    data += floatToData(x);
-    data += floatToData(y);
-    data += floatToData(z);
+    player->lastValidPos = UVector(x, y, z); // The client will sync this position back, it's not a teleport hack
+    player->lastValidTime = timestampNow();
     logMessage(QObject::tr(("UDP: Moving character")));
-    sendMessage(player,MsgUserReliableOrdered4, data);
+    sendMessage(player, MoveRPC::channel, MoveRPC::encode(UVector(x, y, z)));
 }
 
 void sendBeginDialog(Player* player)
 {
-    QByteArray data(1,0);
-    data[0] = 11; // Request number
-    sendMessage(player,MsgUserReliableOrdered4, data);
+    sendMessage(player, BeginDialogRPC::channel, BeginDialogRPC::encode());
 }
 
 void sendDialogMessage(Player* player, QString& message, QString NPCName, quint16 iconId)
@@ -661,68 +638,38 @@ void sendDialogOptions(Player* player, QList<QString>& answers)
 
 void sendEndDialog(Player* player)
 {
-    QByteArray data(1,0);
-    data[0] = 13; // Request number
-    sendMessage(player,MsgUserReliableOrdered4, data);
+    sendMessage(player, EndDialogRPC::channel, EndDialogRPC::encode());
 }
 
 void sendWearItemRPC(Player* player, const WearableItem& item)
 {
-    QByteArray data;
-    data += uint16ToData(player->pony.netviewId);
-    data += 0x8;
-    data += uint32ToData(item.id);
-    data += uint8ToData(item.index);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendWearItemRPC(&player->pony, player, item);
 }
 
 void sendWearItemRPC(Pony* wearing, Player* dest, const WearableItem& item)
 {
-    QByteArray data;
-    data += uint16ToData(wearing->netviewId);
-    data += 0x8;
-    data += uint32ToData(item.id);
-    data += uint8ToData(item.index);
-    sendMessage(dest, MsgUserReliableOrdered18, data);
+    sendMessage(dest, WearItemRPC::channel, WearItemRPC::encode(wearing->netviewId, item.id, item.index));
 }
 
 void sendUnwearItemRPC(Player* player, uint8_t slot)
 {
-    QByteArray data;
-    data += uint16ToData(player->pony.netviewId);
-    data += 0x9;
-    data += uint8ToData(slot);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendUnwearItemRPC(&player->pony, player, slot);
 }
 
 void sendUnwearItemRPC(Pony* wearing, Player* dest, uint8_t slot)
 {
-    QByteArray data;
-    data += uint16ToData(wearing->netviewId);
-    data += 0x9;
-    data += uint8ToData(slot);
-    sendMessage(dest, MsgUserReliableOrdered18, data);
+    sendMessage(dest, UnwearItemRPC::channel, UnwearItemRPC::encode(wearing->netviewId, slot));
 }
 
 void sendAddItemRPC(Player* player, const InventoryItem& item)
 {
-    QByteArray data;
-    data += uint16ToData(player->pony.netviewId);
-    data += 0x6;
-    data += uint32ToData(item.id);
-    data += uint32ToData(item.amount);
-    data += uint32ToData(item.index);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendMessage(player, AddItemRPC::channel,
+                AddItemRPC::encode(player->pony.netviewId, item.id, item.amount, item.index));
 }
 
 void sendDeleteItemRPC(Player* player, uint8_t index, uint32_t qty)
 {
-    QByteArray data;
-    data += uint16ToData(player->pony.netviewId);
-    data += 0x7;
-    data += uint8ToData(index);
-    data += uint32ToData(qty);
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendMessage(player, DeleteItemRPC::channel, DeleteItemRPC::encode(player->pony.netviewId, index, qty));
 }
 
 void sendAddViewAddShop(Player* player, Pony* npcShop)
@@ -757,19 +704,10 @@ void sendBeginShop(Player* player, Pony* npcShop)
 
 void sendEndShop(Player* player)
 {
-    QByteArray data;
-    data += uint16ToData(player->pony.netviewId);
-    data += 0x17; // EndShop
-
-    sendMessage(player, MsgUserReliableOrdered18, data);
+    sendMessage(player, EndShopRPC::channel, EndShopRPC::encode(player->pony.netviewId));
 }
 
 void sendAnimation(Player* player, const Animation* animation)
 {
-    QByteArray data;
-    data += uint16ToData(player->pony.netviewId);
-    data += 0xCA; // Animation
-    data += uint32ToData(animation->id);
-
-    sendMessage(player, MsgUserReliableOrdered12, data);
+    sendMessage(player, AnimationRPC::channel, AnimationRPC::encode(player->pony.netviewId, animation->id));
 }
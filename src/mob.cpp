@@ -4,24 +4,38 @@
 #include "mobsStats.h"
 #include "message.h"
 #include "scene.h"
+#include "entityStreaming.h"
+#include "player.h"
+#include "netviewIndex.h"
+#include "mobRespawn.h"
+#include "serverTick.h"
+#include "utils.h"
+#include <cmath>
 
 QList<Mob*> Mob::mobs;
 QList<Mobzone*> Mob::mobzones;
 
 Mob::Mob(Mobzone* zone)
 {
-    spawnZone = currentZone = zone;
-    sceneName = zone->sceneName;
+    spawnZone = currentZone = leashZone = zone;
+    sceneId = zone->sceneId;
 
-    id = SceneEntity::getNewId();
-    netviewId = id;
-    //netviewId = SceneEntity::getNewNetviewId();
+    allocateId(); // The parser checks that we got one
 
     pos = getRandomPos(zone);
 
     rot = {0, (float)(rand()%4-2), 0, 1};
 
     health = 0; // We need to know the type to know the default healt
+    dead = false;
+    respawnTime = 0;
+    syncRecordVersion = 0;
+    resetAI(timestampNow());
+}
+
+Mobzone* Mob::zone() const
+{
+    return spawnZone;
 }
 
 UVector Mob::getRandomPos(Mobzone* zone)
@@ -92,45 +106,259 @@ void Mob::setType(QString ModelName)
 
 void Mob::takeDamage(unsigned amount)
 {
+    if (dead) // Already waiting to respawn, a late hit or splash doesn't kill it twice
+        return;
     if (health <= (float)amount/defaultDefense[type])
         kill();
     else
     {
         health -= (float)amount/defaultDefense[type];
-        Scene* scene = findScene(sceneName);
-        for (Player* player : scene->players)
-        {
-            sendSetStatRPC(player, netviewId, 1, health);
-        }
+        storeHealth(health);
+        sendHealth();
     }
 }
 
+void Mob::sendHealth()
+{
+    if (!scene)
+        return;
+    for (Player* player : scene->players)
+        if (EntityStreaming::knows(player, netviewId))
+            sendSetStatRPC(player, netviewId, 1, health);
+}
+
 void Mob::kill()
 {
     currentZone = spawnZone;
     health = 0;
+    dead = true;
+    storeHealth(health);
 
-    Scene* scene = findScene(sceneName);
-    for (Player* player : scene->players)
+    if (scene)
     {
-        sendSetStatRPC(player, netviewId, 1, 0);
-        sendNetviewRemove(player, netviewId, NetviewRemoveReasonKill);
+        for (Player* player : scene->players)
+            if (EntityStreaming::knows(player, netviewId))
+                sendSetStatRPC(player, netviewId, 1, 0);
+        scene->entitiesVersion++; // Not in the entities list until it respawns
+        scene->entities.setFlag(storeHandle, EntityStore::Dead, true);
+        EntityStreaming::forget(scene, netviewId, NetviewRemoveReasonKill);
     }
 
-    respawn();
+    // The respawn wheel is shared by every scene, kill can run in a scene job
+    Mob* mob = this;
+    float respawnTime = timestampNow() + defaultRespawnDelay[type];
+    ServerTick::post([mob, respawnTime]()
+    {
+        MobRespawn::schedule(mob, respawnTime);
+    });
 }
 
-void Mob::respawn()
+void Mob::revive()
 {
     currentZone = spawnZone;
     pos = getRandomPos(spawnZone);
     rot = {0, (float)(rand()%4-2), 0, 1};
+    markSyncDirty();
+    history.clear(); // Don't rewind between where it died and where it respawns
+    history.push(timestampNow(), pos, rot);
 
     health = defaultMaxHealth[type];
+    storeHealth(health);
+    resetAI(timestampNow());
+
+    dead = false;
+    if (scene)
+    {
+        scene->entitiesVersion++;
+        scene->entities.setFlag(storeHandle, EntityStore::Dead, false);
+    }
+}
+
+void Mob::respawn()
+{
+    MobRespawn::cancel(this);
+    revive();
 
-    Scene* scene = findScene(sceneName);
+    if (!scene || EntityStreaming::isEnabled()) // The streaming instantiates it again when it's in range
+        return;
     for (Player* player : scene->players)
     {
         sendNetviewInstantiate(player, modelName, netviewId, id, pos, rot);
     }
 }
+
+Mobzone* Mob::zoneAt(const UVector& point) const
+{
+    if (currentZone->contains(point))
+        return currentZone;
+    for (auto it = currentZone->adjacents.constBegin(); it != currentZone->adjacents.constEnd(); ++it)
+        if (it.key()->contains(point))
+            return it.key();
+    // Further away, the routes know the way from here
+    for (Mobzone* zone : currentZone->sceneZones)
+        if (zone->contains(point))
+            return zone;
+    return nullptr;
+}
+
+bool Mob::moveAlongRoute(const UVector& dest, const Mobzone* destZone, float distance)
+{
+    // Another zone we know the way to, go to the line we cross to get closer first
+    if (destZone && destZone != currentZone)
+    {
+        int next = destZone->index < currentZone->routeNext.size() ? currentZone->routeNext[destZone->index] : -1;
+        if (next >= 0)
+        {
+            if (moveTowards(currentZone->routeWaypoint[destZone->index], distance))
+                currentZone = Mob::mobzones[next];
+            return false;
+        }
+    }
+
+    bool reached = moveTowards(dest, distance);
+    if (Mobzone* zone = zoneAt(pos)) // Walked into a neighbour zone without following a route
+        currentZone = zone;
+    return reached;
+}
+
+void Mob::resetAI(float now)
+{
+    aiState = Idle;
+    target = nullptr;
+    targetNetviewId = targetGeneration = 0;
+    lastAIUpdate = nextAggroCheck = now;
+    nextAction = now + MOB_IDLE_MIN + (MOB_IDLE_MAX - MOB_IDLE_MIN) * (rand() / (float)RAND_MAX);
+}
+
+bool Mob::isLookingForTarget(float now) const
+{
+    return (aiState == Idle || aiState == Wander) && defaultAggroRange[type] > 0 && now >= nextAggroCheck;
+}
+
+float Mob::aggroRange() const
+{
+    return defaultAggroRange[type];
+}
+
+void Mob::updateAI(float now, Player* seen)
+{
+    bool looking = isLookingForTarget(now);
+    float dt = qBound<float>(0, now - lastAIUpdate, MOB_AI_MAX_DT);
+    lastAIUpdate = now;
+    if (!scene || health <= 0)
+        return;
+    float speed = defaultMoveSpeed[type];
+
+    // Look around for ponies to attack
+    if (looking)
+    {
+        nextAggroCheck = now + MOB_AGGRO_INTERVAL;
+        if (seen)
+            setTarget(seen);
+    }
+
+    if (aiState == Idle)
+    {
+        if (now >= nextAction)
+        {
+            moveTarget = getRandomPos(currentZone);
+            aiState = Wander;
+        }
+    }
+    else if (aiState == Wander)
+    {
+        if (moveTowards(moveTarget, speed / 2 * dt))
+            resetAI(now);
+    }
+    else if (aiState == Chase || aiState == Attack)
+    {
+        float dx = pos.x - leashOrigin.x;
+        float dz = pos.z - leashOrigin.z;
+        if (!isTargetValid() || dx*dx + dz*dz > MOB_LEASH_DISTANCE * MOB_LEASH_DISTANCE)
+        {
+            target = nullptr;
+            aiState = Leash;
+            return;
+        }
+
+        const UVector& targetPos = target->pony.pos;
+        float range = defaultAttackRange[type];
+        dx = targetPos.x - pos.x;
+        dz = targetPos.z - pos.z;
+        float dist = sqrt(dx*dx + dz*dz);
+        if (aiState == Attack && dist > range * 1.2f) // A bit of slack, so a target on the edge doesn't make us go back and forth
+            aiState = Chase;
+        if (aiState == Chase)
+        {
+            // Stop a bit inside the attack range
+            if (dist > range && !moveAlongRoute(targetPos, zoneAt(targetPos), qMin(speed * dt, dist - range * 0.8f)))
+                return;
+            aiState = Attack;
+        }
+        if (now >= nextAction)
+        {
+            nextAction = now + defaultAttackInterval[type];
+            target->pony.takeDamage(defaultAttackDamage[type]);
+        }
+    }
+    else if (aiState == Leash)
+    {
+        if (moveAlongRoute(leashOrigin, leashZone, speed * 1.5f * dt))
+        {
+            if (health < defaultMaxHealth[type])
+            {
+                health = defaultMaxHealth[type];
+                storeHealth(health);
+                sendHealth();
+            }
+            resetAI(now);
+        }
+    }
+}
+
+bool Mob::moveTowards(const UVector& dest, float distance)
+{
+    float dx = dest.x - pos.x;
+    float dy = dest.y - pos.y;
+    float dz = dest.z - pos.z;
+    float length = sqrt(dx*dx + dy*dy + dz*dz);
+    if (length <= distance)
+    {
+        if (length > 0)
+        {
+            pos = dest;
+            markSyncDirty();
+            history.push(timestampNow(), pos, rot, app.syncInterval / 1000.f);
+        }
+        return true;
+    }
+    if (distance <= 0)
+        return false;
+
+    float t = distance / length;
+    pos.x += dx * t;
+    pos.y += dy * t;
+    pos.z += dz * t;
+    rot.y = atan2(dx, dz);
+    markSyncDirty();
+    history.push(timestampNow(), pos, rot, app.syncInterval / 1000.f); // For the lag compensation of the skills
+    return false;
+}
+
+bool Mob::isTargetValid() const
+{
+    return target && NetviewIndex::findPlayer(targetNetviewId) == target
+            && SceneEntity::idAllocator.isCurrent(targetNetviewId, targetGeneration)
+            && target->inGame >= 3 && target->pony.scene == scene && !target->pony.dead;
+}
+
+void Mob::setTarget(Player* player)
+{
+    target = player;
+    targetNetviewId = player->pony.netviewId;
+    targetGeneration = player->pony.idGeneration;
+    leashOrigin = pos;
+    leashZone = currentZone;
+    aiState = Chase;
+    nextAction = lastAIUpdate; // The first attack as soon as we're in range
+}
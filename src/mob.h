@@ -4,8 +4,16 @@
 #include "sceneEntity.h"
 #include "statsComponent.h"
 #include <QString>
+#include <QByteArray>
 
-class Mobzone;
+#define MOB_AI_MAX_DT 1 // Longest step in s of a mob's AI, a mob that waited longer than this for its turn doesn't jump ahead
+#define MOB_AGGRO_INTERVAL 0.5 // Time in s between two looks around of a mob that isn't fighting
+#define MOB_LEASH_DISTANCE 50 // Distance from where it started chasing after which a mob gives up and goes back
+#define MOB_IDLE_MIN 3 // Time in s a mob rests between two wanders
+#define MOB_IDLE_MAX 10
+
+struct Mobzone;
+class Player;
 
 class Mob : public SceneEntity, public StatsComponent
 {
@@ -22,22 +30,57 @@ public:
         timberwolf
     };
 
+    enum AIState : quint8
+    {
+        Idle, // Resting, looks around for ponies to attack
+        Wander, // Walking to a random point of its zone, looks around too
+        Chase, // Running after its target
+        Attack, // In range of its target, hits it every attack interval
+        Leash // Went too far, goes back where it started chasing and heals. Ignores the ponies meanwhile
+    };
+
 public:
     explicit Mob(Mobzone* zone);
+    virtual ~Mob()=default;
     void setType(QString ModelName); ///< Don't change the SceneEntity model name directly
-    virtual void kill() override; ///< Kills the mob. He'll respawn
-    virtual void respawn() override; ///< Resets the mob
+    virtual void kill() override; ///< Kills the mob. He'll respawn after his type's delay, see MobRespawn
+    virtual void respawn() override; ///< Resets the mob and instantiates it for the players of its scene
+    void revive(); ///< Resets the mob without telling the players, MobRespawn instantiates the mobs it revives together
     virtual void takeDamage(unsigned amount) override; ///< Remove health, update the client, may kill the mob
+    void updateAI(float now, Player* seen); ///< Runs the mob's state machine since its last update, see MobAI. seen is the nearest pony in aggro range, if the mob was looking
+    bool isLookingForTarget(float now) const; ///< True if the next updateAI wants the nearest pony in aggro range
+    float aggroRange() const;
+    Mobzone* zone() const; ///< Zone the mob spawns in
 
 private:
     static UVector getRandomPos(Mobzone* zone); ///< Returns a random position in this zone
+    bool moveTowards(const UVector& dest, float distance); ///< Moves and turns the mob, true once it reached dest
+    bool moveAlongRoute(const UVector& dest, const Mobzone* destZone, float distance); ///< Same, but through the zones between us and destZone
+    Mobzone* zoneAt(const UVector& point) const; ///< Zone of our scene that contains point, nearest to currentZone first. nullptr if none
+    bool isTargetValid() const; ///< False if the target left, died or disconnected
+    void setTarget(Player* player); ///< Starts chasing this player
+    void resetAI(float now); ///< Forgets the target and rests, when the mob respawns or finished leashing
+    void sendHealth(); ///< Sends the mob's health to the players of its scene
 
 public:
     MobType type;
+    AIState aiState;
+    bool dead; // Killed, waiting for MobRespawn. The clients forgot it and the tick systems skip it
+    float respawnTime; // timestampNow() when a dead mob respawns
+    QByteArray syncRecord; // Built by the sync when the mob moved, like Player::syncRecord
+    quint32 syncRecordVersion; // syncVersion when syncRecord was built
 
 private:
     Mobzone* spawnZone;
-    Mobzone* currentZone;
+    Mobzone* currentZone; // Zone the mob walked in, its routes start there
+    Mobzone* leashZone; // Zone the mob was in when it started chasing
+    Player* target; // Pony we're chasing or attacking
+    quint16 targetNetviewId, targetGeneration; // To notice if the target disconnected
+    UVector moveTarget; // Where the mob wanders
+    UVector leashOrigin; // Where the mob started chasing, where it goes back when it leashes
+    float lastAIUpdate; // timestampNow() of the last updateAI
+    float nextAction; // timestampNow() when the mob stops resting, or can attack again
+    float nextAggroCheck; // timestampNow() of the next findTarget
 
 public:
     static QList<Mob*> mobs;
@@ -0,0 +1,57 @@
+#include "mobAI.h"
+#include "mob.h"
+#include "scene.h"
+#include "settings.h"
+#include "proximity.h"
+#include "sceneSimulation.h"
+#include <QElapsedTimer>
+
+bool MobAI::isEnabled()
+{
+    return Settings::mobAiBudget > 0;
+}
+
+void MobAI::updateScene(SceneSimulationJob& job, float now)
+{
+    Scene& scene = *job.scene;
+    int nMobs = scene.mobs.size();
+    if (!isEnabled() || !nMobs || scene.players.isEmpty()) // Nopony would see them, they can wait
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 budget = Settings::mobAiBudget * 1000LL;
+
+    // Each mob at most once per tick, even if we have time left
+    int nVisited = 0;
+    while (nVisited < nMobs)
+    {
+        job.batch.clear();
+        job.points.clear();
+        job.radii.clear();
+        for (; nVisited < nMobs && job.batch.size() < MOBAI_BATCH_SIZE; nVisited++)
+        {
+            if (scene.nextMobAI >= nMobs)
+                scene.nextMobAI = 0;
+            Mob* mob = scene.mobs[scene.nextMobAI++];
+            if (mob->dead) // The dead wait for MobRespawn
+                continue;
+            job.batch << mob;
+            job.points << mob->pos;
+            job.radii << (mob->isLookingForTarget(now) ? mob->aggroRange() : 0);
+        }
+
+        // Who sees who, for the whole batch at once
+        Proximity::nearestPlayers(scene, job.points, job.radii, job.seen);
+        for (int i=0; i<job.batch.size(); i++)
+            job.batch[i]->updateAI(now, job.seen[i]);
+        if (timer.nsecsElapsed() >= budget)
+            break;
+    }
+}
+
+void MobAI::clear()
+{
+    for (Scene& scene : Scene::scenes)
+        scene.nextMobAI = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef MOBAI_H
+#define MOBAI_H
+
+#define MOBAI_BATCH_SIZE 64 // Mobs that look for ponies together, with one Proximity query
+
+class Scene;
+struct SceneSimulationJob;
+
+/// Runs the AI of the mobs of a scene, in the scene's job of the simulation phase (see SceneSimulation).
+/// Each tick continues with the mob after the last one it updated, and stops once it used Settings::mobAiBudget.
+/// With thousands of mobs in a scene, each mob just gets its turn a bit less often, the mobs step by the time since their last turn.
+class MobAI
+{
+public:
+    static bool isEnabled(); ///< False if the mobs stay where they spawn
+    static void updateScene(SceneSimulationJob& job, float now); ///< Updates the job's mobs that fit in the budget, on its worker thread
+    static void clear(); ///< Restarts from the first mob of each scene, when the mobzones are reloaded
+};
+
+#endif // MOBAI_H
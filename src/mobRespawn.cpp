@@ -0,0 +1,109 @@
+#include "mobRespawn.h"
+#include "mob.h"
+#include "scene.h"
+#include "message.h"
+#include "entityStreaming.h"
+#include <cmath>
+
+QVector<Mob*> MobRespawn::wheel[MOB_RESPAWN_SLOTS];
+int MobRespawn::lastSlot = -1;
+int MobRespawn::nPending = 0;
+QVector<Mob*> MobRespawn::due;
+QVector<Scene*> MobRespawn::scenes;
+QVector<Mob*> MobRespawn::sceneMobs;
+
+int MobRespawn::slotOf(float time)
+{
+    return (int)floor(time / MOB_RESPAWN_RESOLUTION);
+}
+
+void MobRespawn::schedule(Mob* mob, float time)
+{
+    mob->respawnTime = time;
+
+    // The current slot was already looked at, the next update takes it
+    int slot = qMax(slotOf(time), lastSlot + 1);
+    wheel[slot % MOB_RESPAWN_SLOTS] << mob;
+    nPending++;
+}
+
+void MobRespawn::cancel(Mob* mob)
+{
+    if (!mob->dead)
+        return;
+    // Rare (instance copies of a dead mob, commands), look everywhere rather than remembering the slot
+    for (QVector<Mob*>& slot : wheel)
+    {
+        int index = slot.indexOf(mob);
+        if (index < 0)
+            continue;
+        slot[index] = slot.last();
+        slot.removeLast();
+        nPending--;
+        return;
+    }
+}
+
+void MobRespawn::update(float now)
+{
+    int nowSlot = slotOf(now);
+    if (lastSlot < 0)
+        lastSlot = nowSlot - 1;
+    if (nowSlot <= lastSlot || !nPending)
+    {
+        lastSlot = qMax(lastSlot, nowSlot);
+        return;
+    }
+
+    // Every slot the time went through since the last update, but each one once even after a long stall
+    due.clear();
+    int nSlots = qMin(nowSlot - lastSlot, MOB_RESPAWN_SLOTS);
+    for (int i=1; i<=nSlots; i++)
+    {
+        QVector<Mob*>& slot = wheel[(lastSlot + i) % MOB_RESPAWN_SLOTS];
+        for (int j=slot.size()-1; j>=0; j--)
+        {
+            if (slotOf(slot[j]->respawnTime) > nowSlot) // Due in a later turn of the wheel
+                continue;
+            due << slot[j];
+            slot[j] = slot.last();
+            slot.removeLast();
+        }
+    }
+    lastSlot = nowSlot;
+    if (due.isEmpty())
+        return;
+    nPending -= due.size();
+
+    // Revive them all, then one instantiate batch per scene instead of a burst of messages per mob
+    scenes.clear();
+    for (Mob* mob : due)
+    {
+        mob->revive();
+        if (mob->scene && !scenes.contains(mob->scene))
+            scenes << mob->scene;
+    }
+    if (EntityStreaming::isEnabled()) // The streaming instantiates them when they're in range
+        return;
+    for (Scene* scene : scenes)
+    {
+        sceneMobs.clear();
+        for (Mob* mob : due)
+            if (mob->scene == scene)
+                sceneMobs << mob;
+        sendNetviewInstantiate(scene, sceneMobs);
+    }
+}
+
+void MobRespawn::clear()
+{
+    for (QVector<Mob*>& slot : wheel)
+        slot.clear();
+    lastSlot = -1;
+    nPending = 0;
+}
+
+int MobRespawn::pending()
+{
+    return nPending;
+}
@@ -0,0 +1,39 @@
+#ifndef MOBRESPAWN_H
+#define MOBRESPAWN_H
+
+#include <QVector>
+
+#define MOB_RESPAWN_SLOTS 256 // Slots of the wheel, a full turn is MOB_RESPAWN_SLOTS*MOB_RESPAWN_RESOLUTION seconds
+#define MOB_RESPAWN_RESOLUTION 0.25 // Time in s covered by a slot. The respawns of a slot happen in the same tick
+
+class Mob;
+class Scene;
+
+/// Respawns the killed mobs after the delay of their type, from a timer wheel.
+/// A dead mob waits in the slot of its respawn time, each update only looks at the slots the time went through,
+/// so the thousands of dead mobs waiting cost nothing until they're due. Delays longer than a turn of the wheel
+/// just stay in their slot for the next turns.
+/// The mobs due in the same update are instantiated together, one batch per scene for each of its players.
+class MobRespawn
+{
+public:
+    static void schedule(Mob* mob, float time); ///< Respawns this dead mob at timestampNow() time
+    static void cancel(Mob* mob); ///< Forgets the mob, when it's respawned directly. Does nothing if it isn't waiting
+    static void update(float now); ///< Respawns the mobs that are due, on the main thread
+    static void clear(); ///< Forgets every dead mob, when the mobs are deleted
+    static int pending(); ///< Number of dead mobs waiting
+
+private:
+    static int slotOf(float time);
+
+private:
+    static QVector<Mob*> wheel[MOB_RESPAWN_SLOTS];
+    static int lastSlot; // Absolute slot (time/MOB_RESPAWN_RESOLUTION) of the last update, -1 before the first one
+    static int nPending;
+    // The respawns of the current update, kept between updates to reuse their memory
+    static QVector<Mob*> due;
+    static QVector<Scene*> scenes;
+    static QVector<Mob*> sceneMobs;
+};
+
+#endif // MOBRESPAWN_H
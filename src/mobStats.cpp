@@ -3,3 +3,15 @@
 unsigned defaultMaxHealth[] = {75, 30, 100, 100, 75, 100, 100, 100};
 
 float defaultDefense[] = {1, 1, 1.5, 10, 0.75, 1, 0.85, 1};
+
+float defaultMoveSpeed[] = {3, 6, 5, 6, 8, 5, 3, 7};
+
+float defaultAggroRange[] = {15, 0, 15, 25, 20, 15, 12, 20};
+
+float defaultAttackRange[] = {3, 2, 3, 6, 2.5, 3, 3, 3};
+
+unsigned defaultAttackDamage[] = {10, 0, 12, 30, 6, 10, 12, 10};
+
+float defaultAttackInterval[] = {2, 1, 1.5, 3, 1, 1.5, 2, 1.2};
+
+float defaultRespawnDelay[] = {30, 10, 45, 300, 20, 30, 30, 30};
@@ -4,6 +4,10 @@
 #include "mobzone.h"
 #include "mobsParser.h"
 #include "app.h"
+#include "scene.h"
+#include "netviewIndex.h"
+#include "log.h"
+#include <cmath>
 
 void parseMobzoneData(QByteArray data)
 {
@@ -47,15 +51,30 @@ void parseMobzoneData(QByteArray data)
 
             zone->end = UVector{x,y,z};
         }
+        else if (line.startsWith("name "))
+        {
+            zone->name = line.mid(5).trimmed().toLower();
+        }
+        else if (line.startsWith("link "))
+        {
+            zone->links << line.mid(5).trimmed().toLower();
+        }
         else if (line.startsWith("scene "))
         {
             line = line.mid(6);
-            zone->sceneName = line;
+            zone->sceneId = findSceneId(line);
+            if (zone->sceneId == INVALID_SCENE_ID)
+                throw QString(QObject::tr("parseMobzoneData(): unknown scene %1").arg(line));
         }
         else if (line.startsWith("mob "))
         {
             line = line.mid(4);
+            Scene* scene = findScene(zone->sceneId);
+            if (!scene)
+                throw QString(QObject::tr("parseMobzoneData(): mob declared before the zone's scene"));
             Mob* mob = new Mob(zone);
+            if (!mob->hasCurrentId())
+                throw QString(QObject::tr("parseMobzoneData(): no free netviewId left for the mob"));
             QStringList args = line.split(',');
             for (QString arg : args)
             {
@@ -69,8 +88,11 @@ void parseMobzoneData(QByteArray data)
                     mob->setType("mobs/"+value);
                 else
                     throw QString(QObject::tr("parseMobzoneData(): error reading mob arg, unknown arg %1").arg(key));
-                Mob::mobs << mob;
             }
+            Mob::mobs << mob;
+            zone->mobs << mob;
+            scene->addMob(mob);
+            NetviewIndex::addMob(mob->netviewId, mob);
         }
         else
         {
@@ -78,5 +100,141 @@ void parseMobzoneData(QByteArray data)
         }
     }
 
+    zone->index = Mob::mobzones.size();
     Mob::mobzones << zone;
 }
+
+// One axis of the line between two zones: the overlap of their intervals if they overlap, else the gap between them
+static bool axisSpan(float aMin, float aMax, float bMin, float bMax, float& aSide, float& bSide)
+{
+    float lo = qMax(aMin, bMin), hi = qMin(aMax, bMax);
+    if (lo <= hi)
+    {
+        aSide = lo;
+        bSide = hi;
+        return true;
+    }
+    aSide = aMax < bMin ? aMax : aMin;
+    bSide = aMax < bMin ? bMin : bMax;
+    return false;
+}
+
+// Line the mobs cross to go from a to b: their shared edge if they touch, else the shortest way across the gap
+static QPair<UVector, UVector> intersectionLine(const Mobzone& a, const Mobzone& b)
+{
+    float ax, bx, az, bz;
+    bool overlapX = axisSpan(qMin(a.start.x, a.end.x), qMax(a.start.x, a.end.x), qMin(b.start.x, b.end.x), qMax(b.start.x, b.end.x), ax, bx);
+    bool overlapZ = axisSpan(qMin(a.start.z, a.end.z), qMax(a.start.z, a.end.z), qMin(b.start.z, b.end.z), qMax(b.start.z, b.end.z), az, bz);
+    float y = (a.center().y + b.center().y) / 2;
+    float midX = (ax+bx)/2, midZ = (az+bz)/2;
+    if (overlapX && (!overlapZ || bx-ax >= bz-az)) // Along x, in the middle of the zones' z overlap or across their z gap
+        return overlapZ ? qMakePair(UVector(ax, y, midZ), UVector(bx, y, midZ))
+                        : qMakePair(UVector(midX, y, az), UVector(midX, y, bz));
+    if (overlapZ)
+        return overlapX ? qMakePair(UVector(midX, y, az), UVector(midX, y, bz))
+                        : qMakePair(UVector(ax, y, midZ), UVector(bx, y, midZ));
+    return qMakePair(UVector(ax, y, az), UVector(bx, y, bz)); // Corner to corner
+}
+
+static bool areAdjacent(const Mobzone& a, const Mobzone& b)
+{
+    if (a.sceneId != b.sceneId)
+        return false;
+    float d = MOBZONE_ADJACENT_DISTANCE;
+    return qMax(qMin(a.start.x, a.end.x), qMin(b.start.x, b.end.x)) <= qMin(qMax(a.start.x, a.end.x), qMax(b.start.x, b.end.x)) + d
+            && qMax(qMin(a.start.z, a.end.z), qMin(b.start.z, b.end.z)) <= qMin(qMax(a.start.z, a.end.z), qMax(b.start.z, b.end.z)) + d;
+}
+
+static void addAdjacent(Mobzone* a, Mobzone* b)
+{
+    a->adjacents.insert(b, intersectionLine(*a, *b));
+    b->adjacents.insert(a, intersectionLine(*b, *a));
+}
+
+static UVector middle(const QPair<UVector, UVector>& line)
+{
+    return UVector((line.first.x+line.second.x)/2, (line.first.y+line.second.y)/2, (line.first.z+line.second.z)/2);
+}
+
+static float distance(const UVector& a, const UVector& b)
+{
+    float dx = a.x-b.x, dy = a.y-b.y, dz = a.z-b.z;
+    return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+void linkMobzones()
+{
+    QList<Mobzone*>& zones = Mob::mobzones;
+    int nZones = zones.size();
+
+    // The graph: zones that touch, and the links of the files
+    for (int i=0; i<nZones; i++)
+    {
+        zones[i]->adjacents.clear();
+        zones[i]->sceneZones.clear();
+        for (int j=0; j<nZones; j++)
+            if (zones[j]->sceneId == zones[i]->sceneId)
+                zones[i]->sceneZones << zones[j];
+        for (int j=0; j<i; j++)
+            if (areAdjacent(*zones[i], *zones[j]))
+                addAdjacent(zones[i], zones[j]);
+    }
+    for (Mobzone* zone : zones)
+    {
+        for (const QString& link : zone->links)
+        {
+            Mobzone* other = nullptr;
+            for (Mobzone* candidate : zones)
+                if (candidate->name == link)
+                    other = candidate;
+            if (!other || other == zone)
+                logError(QObject::tr("Mobzone %1 links to unknown zone %2").arg(zone->name).arg(link));
+            else if (other->sceneId != zone->sceneId)
+                logError(QObject::tr("Mobzone %1 links to zone %2 of another scene").arg(zone->name).arg(link));
+            else if (!zone->adjacents.contains(other))
+                addAdjacent(zone, other);
+        }
+    }
+
+    // The routes, from the middle of the zones through the middle of the intersection lines. Few zones, Dijkstra from each one
+    QVector<float> cost(nZones);
+    QVector<int> firstHop(nZones);
+    QVector<bool> done(nZones);
+    for (Mobzone* source : zones)
+    {
+        cost.fill(-1);
+        firstHop.fill(-1);
+        done.fill(false);
+        cost[source->index] = 0;
+        for (;;)
+        {
+            int current = -1;
+            for (int i=0; i<nZones; i++)
+                if (!done[i] && cost[i] >= 0 && (current < 0 || cost[i] < cost[current]))
+                    current = i;
+            if (current < 0)
+                break;
+            done[current] = true;
+            Mobzone* zone = zones[current];
+            for (auto it = zone->adjacents.constBegin(); it != zone->adjacents.constEnd(); ++it)
+            {
+                int next = it.key()->index;
+                UVector crossing = middle(it.value());
+                float nextCost = cost[current] + distance(zone->center(), crossing) + distance(crossing, it.key()->center());
+                if (done[next] || (cost[next] >= 0 && cost[next] <= nextCost))
+                    continue;
+                cost[next] = nextCost;
+                firstHop[next] = current == source->index ? next : firstHop[current];
+            }
+        }
+
+        source->routeNext = firstHop;
+        source->routeWaypoint.fill(UVector(), nZones);
+        for (int i=0; i<nZones; i++)
+        {
+            if (firstHop[i] < 0)
+                continue;
+            source->routeWaypoint[i] = middle(source->adjacents.value(zones[firstHop[i]]));
+        }
+    }
+}
@@ -4,5 +4,6 @@
 #include <QByteArray>
 
 void parseMobzoneData(QByteArray data);
+void linkMobzones(); ///< Builds the graph of adjacent zones and the routes between them, once all the zones are loaded
 
 #endif // MOBSPARSER_H
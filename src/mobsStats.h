@@ -10,5 +10,11 @@
 
 extern unsigned defaultMaxHealth[];
 extern float defaultDefense[];
+extern float defaultMoveSpeed[]; // Units per second when chasing, they wander at half speed
+extern float defaultAggroRange[]; // Distance at which the mob attacks a pony on sight, 0 if it never starts a fight
+extern float defaultAttackRange[];
+extern unsigned defaultAttackDamage[];
+extern float defaultAttackInterval[]; // Time in s between two attacks
+extern float defaultRespawnDelay[]; // Time in s a killed mob stays dead
 
 #endif // MOBSSTATS_H
@@ -0,0 +1,12 @@
+#include "mobzone.h"
+
+bool Mobzone::contains(const UVector& pos) const
+{
+    return pos.x >= qMin(start.x, end.x) && pos.x <= qMax(start.x, end.x)
+            && pos.z >= qMin(start.z, end.z) && pos.z <= qMax(start.z, end.z);
+}
+
+UVector Mobzone::center() const
+{
+    return UVector((start.x+end.x)/2, (start.y+end.y)/2, (start.z+end.z)/2);
+}
@@ -2,14 +2,32 @@
 #define MOBZONE_H
 
 #include "dataType.h"
+#include "scene.h"
 #include <QMap>
 #include <QPair>
+#include <QList>
+#include <QVector>
+#include <QStringList>
+
+#define MOBZONE_ADJACENT_DISTANCE 2 // Zones of a scene closer than this on the x/z plane are adjacent, the mobs can walk from one to the other
+
+class Mob;
 
 struct Mobzone
 {
+    QString name; ///< Optional, to link zones by name
     UVector start, end; ///< Bounds of the mobzone
-    QString sceneName;
-    QMap<Mobzone, QPair<UVector, UVector>> adjacents; ///< Map of adjacent mobzones, and the intersection line
+    SceneId sceneId = INVALID_SCENE_ID; ///< Scene the zone is on
+    int index = -1; ///< Index in Mob::mobzones
+    QStringList links; ///< Names of zones the mobs can walk to even if they're not adjacent, resolved by linkMobzones
+    QList<Mobzone*> sceneZones; ///< Every zone of the same scene, this one included. Filled by linkMobzones
+    QMap<Mobzone*, QPair<UVector, UVector>> adjacents; ///< Map of adjacent mobzones, and the intersection line
+    QVector<int> routeNext; ///< By index of the destination zone: index of the next zone on the shortest route, -1 if there's no route
+    QVector<UVector> routeWaypoint; ///< By index of the destination zone: where to cross into the next zone, middle of the intersection line
+    QList<Mob*> mobs; ///< Mobs that spawn in this zone, in every instance of its scene
+
+    bool contains(const UVector& pos) const; ///< Whether pos is in the bounds, on the x/z plane
+    UVector center() const;
 };
 
 #endif // MOBZONE_H
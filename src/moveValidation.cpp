@@ -0,0 +1,167 @@
+#include "moveValidation.h"
+#include "scene.h"
+#include "player.h"
+#include "message.h"
+#include "settings.h"
+#include "app.h"
+#include "rpc.h"
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOVE_VALIDATION_SSE
+#include <emmintrin.h>
+#endif
+
+#define MOVE_MAX_DT 1 // Longest time in s we allow for a move, or waiting would allow to teleport
+
+QVector<float> MoveValidation::oldX, MoveValidation::oldZ;
+QVector<float> MoveValidation::newX, MoveValidation::newY, MoveValidation::newZ;
+QVector<float> MoveValidation::maxDist2;
+QVector<int> MoveValidation::flags;
+
+// NaN isn't a position, use the fallback for it
+static float clampCoord(float v, float min, float max, float fallback)
+{
+    if (v != v)
+        return fallback;
+    return qBound(min, v, max);
+}
+
+void MoveValidation::validate(float now)
+{
+    for (int i=0; i<Scene::scenes.size(); i++)
+    {
+        Scene& scene = Scene::scenes[i];
+        if (scene.movedPlayers.isEmpty())
+            continue;
+        validateScene(scene, now);
+        scene.movedPlayers.clear();
+    }
+}
+
+void MoveValidation::validateScene(Scene& scene, float now)
+{
+    int count = scene.movedPlayers.size();
+    int padded = (count + 3) & ~3;
+    oldX.resize(padded);
+    oldZ.resize(padded);
+    newX.resize(padded);
+    newY.resize(padded);
+    newZ.resize(padded);
+    maxDist2.resize(padded);
+    flags.resize(padded);
+
+    for (int i=0; i<padded; i++)
+    {
+        if (i >= count) // Padding, always valid
+        {
+            oldX[i] = newX[i] = scene.boundsMin.x;
+            oldZ[i] = newZ[i] = scene.boundsMin.z;
+            newY[i] = scene.boundsMin.y;
+            maxDist2[i] = FLT_MAX;
+            continue;
+        }
+        const Player* player = scene.movedPlayers[i];
+        oldX[i] = player->lastValidPos.x;
+        oldZ[i] = player->lastValidPos.z;
+        newX[i] = player->pony.pos.x;
+        newY[i] = player->pony.pos.y;
+        newZ[i] = player->pony.pos.z;
+        if (Settings::maxMoveSpeed > 0)
+        {
+            float dt = qBound<float>(MOVE_MIN_DT, now - player->lastValidTime, MOVE_MAX_DT);
+            float maxDist = Settings::maxMoveSpeed * dt + MOVE_DISTANCE_TOLERANCE;
+            maxDist2[i] = maxDist * maxDist;
+        }
+        else
+            maxDist2[i] = FLT_MAX;
+    }
+
+    checkBatch(scene, padded);
+
+    for (int i=0; i<count; i++)
+    {
+        Player* player = scene.movedPlayers[i];
+        player->pendingValidation = false;
+        UVector& pos = player->pony.pos;
+        if (!flags[i])
+        {
+            player->lastValidPos = pos;
+            player->lastValidTime = now;
+            continue;
+        }
+
+        if (flags[i] & SpeedViolation) // Too far from where we know the pony was, back to it
+        {
+            scene.nSpeedViolations++;
+            pos = player->lastValidPos;
+        }
+        else
+        {
+            if (flags[i] & HeightViolation)
+            {
+                scene.nHeightViolations++;
+                pos.y = clampCoord(pos.y, scene.boundsMin.y, scene.boundsMax.y, player->lastValidPos.y);
+            }
+            if (flags[i] & BoundsViolation)
+            {
+                scene.nBoundsViolations++;
+                pos.x = clampCoord(pos.x, scene.boundsMin.x, scene.boundsMax.x, player->lastValidPos.x);
+                pos.z = clampCoord(pos.z, scene.boundsMin.z, scene.boundsMax.z, player->lastValidPos.z);
+            }
+            player->lastValidPos = pos;
+            player->lastValidTime = now;
+        }
+
+        // Correct the client and everyone that would see the bad position
+        player->pony.markSyncDirty();
+        player->pony.history.push(now, pos, player->pony.rot, app.syncInterval / 1000.f);
+        scene.grid.update(player, pos);
+        sendMessage(player, MoveRPC::channel, MoveRPC::encode(pos));
+    }
+}
+
+void MoveValidation::checkBatch(const Scene& scene, int count)
+{
+    // The comparisons are written as "not inside" so that a NaN is always a violation
+#ifdef MOVE_VALIDATION_SSE
+    const __m128 minX = _mm_set1_ps(scene.boundsMin.x), maxX = _mm_set1_ps(scene.boundsMax.x);
+    const __m128 minY = _mm_set1_ps(scene.boundsMin.y), maxY = _mm_set1_ps(scene.boundsMax.y);
+    const __m128 minZ = _mm_set1_ps(scene.boundsMin.z), maxZ = _mm_set1_ps(scene.boundsMax.z);
+    for (int i=0; i<count; i+=4)
+    {
+        __m128 x = _mm_loadu_ps(&newX[i]);
+        __m128 y = _mm_loadu_ps(&newY[i]);
+        __m128 z = _mm_loadu_ps(&newZ[i]);
+        __m128 dx = _mm_sub_ps(x, _mm_loadu_ps(&oldX[i]));
+        __m128 dz = _mm_sub_ps(z, _mm_loadu_ps(&oldZ[i]));
+        __m128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+
+        int speedOk = _mm_movemask_ps(_mm_cmple_ps(dist2, _mm_loadu_ps(&maxDist2[i])));
+        int heightOk = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(y, minY), _mm_cmple_ps(y, maxY)));
+        int boundsOk = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, minX), _mm_cmple_ps(x, maxX)),
+                                                  _mm_and_ps(_mm_cmpge_ps(z, minZ), _mm_cmple_ps(z, maxZ))));
+        for (int j=0; j<4; j++)
+        {
+            flags[i+j] = (((speedOk >> j) & 1) ? 0 : SpeedViolation)
+                    | (((heightOk >> j) & 1) ? 0 : HeightViolation)
+                    | (((boundsOk >> j) & 1) ? 0 : BoundsViolation);
+        }
+    }
+#else
+    for (int i=0; i<count; i++)
+    {
+        float dx = newX[i] - oldX[i];
+        float dz = newZ[i] - oldZ[i];
+        int violations = 0;
+        if (!(dx*dx + dz*dz <= maxDist2[i]))
+            violations |= SpeedViolation;
+        if (!(newY[i] >= scene.boundsMin.y && newY[i] <= scene.boundsMax.y))
+            violations |= HeightViolation;
+        if (!(newX[i] >= scene.boundsMin.x && newX[i] <= scene.boundsMax.x
+              && newZ[i] >= scene.boundsMin.z && newZ[i] <= scene.boundsMax.z))
+            violations |= BoundsViolation;
+        flags[i] = violations;
+    }
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef MOVEVALIDATION_H
+#define MOVEVALIDATION_H
+
+#include <QVector>
+
+#define MOVE_DISTANCE_TOLERANCE 5 // Distance a pony can move past maxMoveSpeed, for the jitter of the clients' timestamps
+#define MOVE_MIN_DT 0.05 // Shortest time in s we allow for a move, two syncs received at once still get some distance
+
+class Scene;
+
+/// Checks the positions the clients sent during the tick, all at once.
+/// A move that's too fast is rejected, a position out of the scene's bounds is clamped,
+/// and the client is moved back to where the server thinks it is.
+class MoveValidation
+{
+public:
+    enum Violation
+    {
+        SpeedViolation = 1,
+        HeightViolation = 2,
+        BoundsViolation = 4
+    };
+
+public:
+    static void validate(float now); ///< Validates the moves of every scene
+
+private:
+    static void validateScene(Scene& scene, float now);
+    static void checkBatch(const Scene& scene, int count); ///< Fills flags for the first count moves of the batch
+
+private:
+    // The batch, as structure of arrays padded to a multiple of 4 so it can be checked 4 moves at a time
+    static QVector<float> oldX, oldZ; // Last valid position
+    static QVector<float> newX, newY, newZ; // Position the client sent
+    static QVector<float> maxDist2; // Squared distance the pony was allowed to move since its last valid position
+    static QVector<int> flags; // Violations found for each move
+};
+
+#endif // MOVEVALIDATION_H
@@ -0,0 +1,83 @@
+#include "netviewIndex.h"
+#include "player.h"
+#include "mob.h"
+
+NetviewRef NetviewIndex::refs[65536];
+
+void NetviewIndex::addPlayer(quint16 netviewId, Player* player)
+{
+    refs[netviewId].type = NetviewRef::PlayerPony;
+    refs[netviewId].player = player;
+}
+
+void NetviewIndex::addNpc(quint16 netviewId, Pony* npc)
+{
+    refs[netviewId].type = NetviewRef::Npc;
+    refs[netviewId].npc = npc;
+}
+
+void NetviewIndex::addMob(quint16 netviewId, Mob* mob)
+{
+    refs[netviewId].type = NetviewRef::MobEntity;
+    refs[netviewId].mob = mob;
+}
+
+void NetviewIndex::remove(quint16 netviewId, const void* entity)
+{
+    NetviewRef& ref = refs[netviewId];
+    const void* current = nullptr;
+    if (ref.type == NetviewRef::PlayerPony)
+        current = ref.player;
+    else if (ref.type == NetviewRef::Npc)
+        current = ref.npc;
+    else if (ref.type == NetviewRef::MobEntity)
+        current = ref.mob;
+
+    // The id may have been given to someone else already
+    if (current != entity)
+        return;
+    ref.type = NetviewRef::None;
+    ref.player = nullptr;
+}
+
+void NetviewIndex::clear()
+{
+    for (NetviewRef& ref : refs)
+    {
+        ref.type = NetviewRef::None;
+        ref.player = nullptr;
+    }
+}
+
+const NetviewRef& NetviewIndex::find(quint16 netviewId)
+{
+    return refs[netviewId];
+}
+
+Player* NetviewIndex::findPlayer(quint16 netviewId)
+{
+    const NetviewRef& ref = refs[netviewId];
+    return ref.type == NetviewRef::PlayerPony ? ref.player : nullptr;
+}
+
+Pony* NetviewIndex::findNpc(quint16 netviewId)
+{
+    const NetviewRef& ref = refs[netviewId];
+    return ref.type == NetviewRef::Npc ? ref.npc : nullptr;
+}
+
+Mob* NetviewIndex::findMob(quint16 netviewId)
+{
+    const NetviewRef& ref = refs[netviewId];
+    return ref.type == NetviewRef::MobEntity ? ref.mob : nullptr;
+}
+
+Pony* NetviewIndex::findPony(quint16 netviewId)
+{
+    const NetviewRef& ref = refs[netviewId];
+    if (ref.type == NetviewRef::PlayerPony)
+        return &ref.player->pony;
+    else if (ref.type == NetviewRef::Npc)
+        return ref.npc;
+    return nullptr;
+}
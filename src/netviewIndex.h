@@ -0,0 +1,52 @@
+#ifndef NETVIEWINDEX_H
+#define NETVIEWINDEX_H
+
+#include <QtGlobal>
+
+class Player;
+struct Pony;
+class Mob;
+
+/// What a netviewId refers to
+struct NetviewRef
+{
+    enum Type : quint8
+    {
+        None,
+        PlayerPony, ///< The pony of a connected player
+        Npc,
+        MobEntity
+    };
+
+    Type type;
+    union
+    {
+        Player* player;
+        Pony* npc;
+        Mob* mob;
+    };
+};
+
+/// Dense table of every netviewId in use, so resolving the target of a message is a single array access.
+/// Entities are added when they get their id and spawn, and removed when they're destroyed.
+/// Only used from the main thread.
+class NetviewIndex
+{
+public:
+    static void addPlayer(quint16 netviewId, Player* player);
+    static void addNpc(quint16 netviewId, Pony* npc);
+    static void addMob(quint16 netviewId, Mob* mob);
+    static void remove(quint16 netviewId, const void* entity); ///< Removes the entry, only if it still points to this entity
+    static void clear(); ///< Forgets every entity
+
+    static const NetviewRef& find(quint16 netviewId); ///< type is None if the id is free
+    static Player* findPlayer(quint16 netviewId); ///< nullptr if the id isn't a player's pony
+    static Pony* findNpc(quint16 netviewId); ///< nullptr if the id isn't a NPC
+    static Mob* findMob(quint16 netviewId); ///< nullptr if the id isn't a mob
+    static Pony* findPony(quint16 netviewId); ///< Pony of a player or a NPC, nullptr otherwise
+
+private:
+    static NetviewRef refs[65536];
+};
+
+#endif // NETVIEWINDEX_H
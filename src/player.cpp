@@ -9,6 +9,10 @@
 #include "log.h"
 #include "udp.h"
 #include "items.h"
+#include "skill.h"
+#include "netviewIndex.h"
+#include "entityStreaming.h"
+#include "serverTick.h"
 #include <QUdpSocket>
 #ifdef USE_GUI
 #include <QSettings>
@@ -25,9 +29,13 @@ SceneEntity::SceneEntity()
     modelName = QString();
     id = 0;
     netviewId = 0;
+    idGeneration = 0;
     pos=UVector(0,0,0);
     rot=UQuaternion(0,0,0,0);
-    sceneName = QString();
+    sceneId = INVALID_SCENE_ID;
+    scene = nullptr;
+    storeHandle = INVALID_ENTITY_HANDLE;
+    markSyncDirty();
 }
 
 Pony::Pony(Player *Owner)
@@ -64,8 +72,15 @@ Player::Player()
     inGame=0;
     accessLvl=0;
     nReceivedDups=0;
+    nReliableBytes=0;
     lastPingNumber=0;
     lastPingTime=timestampNow();
+    sentPingNumber=0;
+    sentPingTime=0;
+    rtt=0;
+    lastValidTime=0;
+    syncRecordVersion=0;
+    pendingValidation=false;
     port=0;
     IP=QString();
     receivedDatas = new QByteArray();
@@ -102,26 +117,42 @@ void Player::reset()
     connected=false;
     inGame=0;
     nReceivedDups=0;
+    nReliableBytes=0;
     lastPingNumber=0;
     lastPingTime=timestampNow();
+    sentPingNumber=0;
+    sentPingTime=0;
+    rtt=0;
     port=0;
     IP.clear();
     receivedDatas->clear();
     lastValidReceivedAnimation.clear();
     pony = Pony(this);
+    lastValidPos = UVector();
+    lastValidTime=0;
+    pendingValidation=false;
     for (int i=0;i<33;i++)
         udpSequenceNumbers[i]=0;
     for (int i=0;i<33;i++)
         udpRecvSequenceNumbers[i]=0;
     udpRecvMissing.clear();
+    lastSyncSent.clear();
+    syncInterest.clear();
+    knownEntities.clear();
+    syncRecord.clear();
+    syncRecordVersion = 0;
 }
 
 void Player::resetNetwork()
 {
     connected=false;
     nReceivedDups=0;
+    nReliableBytes=0;
     lastPingNumber=0;
     lastPingTime=timestampNow();
+    sentPingNumber=0;
+    sentPingTime=0;
+    rtt=0;
     port=0;
     IP.clear();
     receivedDatas->clear();
@@ -130,6 +161,11 @@ void Player::resetNetwork()
     for (int i=0;i<33;i++)
         udpRecvSequenceNumbers[i]=0;
     udpRecvMissing.clear();
+    lastSyncSent.clear();
+    syncInterest.clear();
+    knownEntities.clear();
+    syncRecord.clear();
+    syncRecordVersion = 0;
 }
 
 Player* Player::findPlayer(QList<Player*>& players, QString uname)
@@ -156,18 +192,6 @@ Player* Player::findPlayer(QList<Player*>& players, QString uIP, quint16 uport)
     return emptyPlayer;
 }
 
-Player* Player::findPlayer(QList<Player*>& players, quint16 netviewId)
-{
-    for (int i=0; i<players.size(); i++)
-    {
-        if (players[i]->pony.netviewId == netviewId)
-            return players[i];
-    }
-
-    Player* emptyPlayer = new Player();
-    return emptyPlayer;
-}
-
 void Player::removePlayer(QList<Player*>& players, QString uIP, quint16 uport)
 {
     for (int i=0; i<players.size(); i++)
@@ -196,8 +220,6 @@ void Player::updatePlayer(QList<Player*>& players, Player* player)
 
 void Player::disconnectPlayerCleanup(Player* player)
 {
-    static QMutex playerCleanupMutex;
-
     // Save the pony
     QList<Pony> ponies = loadPonies(player);
     for (int i=0; i<ponies.size(); i++)
@@ -210,22 +232,21 @@ void Player::disconnectPlayerCleanup(Player* player)
     QString uIP = player->IP;
     quint16 uPort = player->port;
 
-    Scene* scene = findScene(player->pony.sceneName);
-    if (scene->name.isEmpty())
-        logMessage(tr("UDP: Can't find scene for player cleanup"));
-
-    //app.logMessage("playerCleanup locking");
-    playerCleanupMutex.lock();
-    removePlayer(scene->players, uIP, uPort);
-    for (int i=0; i<scene->players.size(); i++)
-        sendNetviewRemove(scene->players[i], player->pony.netviewId);
+    // Runs on the main thread, never while the scene jobs are running
+    Scene* scene = player->pony.scene; // nullptr if the player didn't spawn yet
+    if (scene)
+    {
+        scene->removePlayer(player);
+        EntityStreaming::forget(scene, player->pony.netviewId);
+    }
+    Skill::cancelEffects(&player->pony);
+    NetviewIndex::remove(player->pony.netviewId, player);
+    player->pony.releaseId();
     player->udpDelayedSend(); // We're about to remove the player, we can't delay the send
     player->udpSendReliableTimer->stop();
     player->udpSendReliableGroupTimer->stop();
     removePlayer(Player::udpPlayers, uIP, uPort);
     delete player;
-    //app.logMessage("playerCleanup unlocking");
-    playerCleanupMutex.unlock();
 }
 
 void Player::udpResendLast()
@@ -291,6 +312,14 @@ void Player::udpDelayedSend()
         return; // Avoid deadlock if sendMessage just locked but didn't have the time to stop the timers
     }
     //udpSendReliableMutex.lock();
+    udpFlushGroupBuffer();
+
+    //app.logMessage("udpDelayedSend unlocking");
+    udpSendReliableMutex.unlock();
+}
+
+void Player::udpFlushGroupBuffer()
+{
 #if DEBUG_LOG
     app.logMessage("UDP: Sending delayed grouped message : "+QString(udpSendReliableGroupBuffer.toHex()));
 #endif
@@ -311,8 +340,6 @@ void Player::udpDelayedSend()
             udpSendReliableGroupBuffer.clear();
             if (!udpSendReliableTimer->isActive())
                 udpSendReliableTimer->start();
-            //app.logMessage("udpDelayedSend unlocking");
-            udpSendReliableMutex.unlock();
             return;
         }
         else if (UDP_LOG_PACKETLOSS)
@@ -330,9 +357,6 @@ void Player::udpDelayedSend()
 
     if (!udpSendReliableTimer->isActive())
         udpSendReliableTimer->start();
-
-    //app.logMessage("udpDelayedSend unlocking");
-    udpSendReliableMutex.unlock();
 }
 
 void Pony::addInventoryItem(quint32 id, quint32 qty)
@@ -428,8 +452,7 @@ void Pony::unwearItemAt(quint8 index)
     }
     sendUnwearItemRPC(owner, index);
 
-    Scene* scene = findScene(sceneName);
-    if (scene->name.isEmpty())
+    if (!scene)
         logMessage(QObject::tr("UDP: Can't find the scene for unwearItem RPC, aborting"));
     else
     {
@@ -479,8 +502,7 @@ bool Pony::tryWearItem(quint8 invSlot)
     worn << item;
     sendWearItemRPC(owner, item);
 
-    Scene* scene = findScene(sceneName);
-    if (scene->name.isEmpty())
+    if (!scene)
         logError(QObject::tr("UDP: Can't find the scene for wearItem RPC, aborting"));
     else
     {
@@ -499,7 +521,9 @@ void Pony::takeDamage(unsigned amount)
     else
     {
         health -= (float)amount/defense;
-        Scene* scene = findScene(sceneName);
+        storeHealth(health);
+        if (!scene)
+            return;
         for (Player* player : scene->players)
         {
             sendSetStatRPC(player, netviewId, 1, health);
@@ -511,13 +535,12 @@ void Pony::kill()
 {
     health = 0;
     dead = true;
+    storeHealth(health);
+    if (scene)
+        scene->entities.setFlag(storeHandle, EntityStore::Dead, true);
 
-    Scene* scene = findScene(sceneName);
-    for (Player* player : scene->players)
-    {
-        if (player->pony.netviewId != netviewId)
-            sendNetviewRemove(player, netviewId, NetviewRemoveReasonKill);
-    }
+    if (scene)
+        EntityStreaming::forget(scene, netviewId, NetviewRemoveReasonKill);
 
     respawn();
 }
@@ -525,7 +548,18 @@ void Pony::kill()
 void Pony::respawn()
 {
     health = maxHealth;
+    storeHealth(health);
 
-    sendLoadSceneRPC(owner, sceneName);
+    // Reloading the scene moves the player between scenes, it can't run in a scene job
+    Player* player = owner;
+    if (player)
+    {
+        ServerTick::post(player, [player]()
+        {
+            sendLoadSceneRPC(player, player->pony.sceneId);
+        });
+    }
     dead = false;
+    if (scene)
+        scene->entities.setFlag(storeHandle, EntityStore::Dead, false);
 }
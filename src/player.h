@@ -8,6 +8,8 @@
 #include <QMutex>
 #include <QByteArray>
 #include <QDateTime>
+#include <QHash>
+#include <QSet>
 #include "dataType.h"
 #include "quest.h"
 #include "sceneEntity.h"
@@ -17,6 +19,13 @@
 #define MAX_WORN_ITEMS 32
 #define PONYDATA_SIZE 43 // Size of the PonyData minus the name
 
+/// What the sync last sent about an entity to a given player
+struct SyncCacheEntry
+{
+    quint32 version; // syncVersion of the entity when we sent it
+    float time; // timestampNow() when we sent it
+};
+
 struct Pony : public SceneEntity, public StatsComponent
 {
 public:
@@ -72,7 +81,6 @@ public:
     static QList<Player*> loadPlayers();
     static Player* findPlayer(QList<Player*>& players, QString uname);
     static Player* findPlayer(QList<Player*>& players, QString uIP, quint16 uport);
-    static Player* findPlayer(QList<Player*>& players, quint16 netviewId);
     static void removePlayer(QList<Player*>& players, QString uIP, quint16 uport);
     static void updatePlayer(QList<Player*>& players, Player* player);
     static void disconnectPlayerCleanup(Player* player);
@@ -84,6 +92,7 @@ public slots:
 public:
     void reset(); // Reconstructs an empty Player
     void resetNetwork(); // Resets all the network-related members
+    void udpFlushGroupBuffer(); // Same as udpDelayedSend, when udpSendReliableMutex is already locked
 
 public:
     QString IP;
@@ -93,6 +102,9 @@ public:
     int accessLvl;
     float lastPingTime;
     int lastPingNumber;
+    quint8 sentPingNumber; // Number of the last ping we sent
+    float sentPingTime; // timestampNow() when we sent it
+    float rtt; // Smoothed round trip time in seconds, measured with our pings
     QDateTime lastOnline; // timestamp in utc of last login
     bool connected;
     quint16 udpSequenceNumbers[33]; // Next seq number to use when sending a message
@@ -108,7 +120,16 @@ public:
     QByteArray lastValidReceivedAnimation;
     quint8 inGame; // 0:Not in game, 1:Loading, 2:Instantiated & waiting savegame, 3:In game and loaded
     quint16 nReceivedDups; // Number of duplicate packets that we didn't miss and had to discard.
+    quint64 nReliableBytes; // Bytes of reliable messages queued for this player, for the scene load bandwidth budget
     QDateTime chatRollCooldownEnd; // When the cooldown for the roll chat command ends
+    QHash<quint16, SyncCacheEntry> lastSyncSent; // Last sync sent to this player, by netviewId of the synced entity
+    QSet<quint16> syncInterest; // netviewIds currently in this player's area of interest
+    QSet<quint16> knownEntities; // netviewIds instantiated on the client, see EntityStreaming
+    QByteArray syncRecord; // Encoded position, shared by every player it's sent to. Rebuilt when the pony moves
+    quint32 syncRecordVersion; // pony.syncVersion when syncRecord was built
+    UVector lastValidPos; // Last position that passed the movement validation
+    float lastValidTime; // timestampNow() of lastValidPos
+    bool pendingValidation; // Whether we're in our scene's movedPlayers
 
 public:
     static QList<Player*> tcpPlayers; // Used by the TCP login server
@@ -161,7 +161,7 @@ void Player::savePonies(Player *player, QList<Pony> ponies)
                 xmlWriter.writeAttribute("z", QString::number(ponies[i].rot.z));
                 xmlWriter.writeAttribute("w", "1");
             xmlWriter.writeEndElement();
-            xmlWriter.writeTextElement("scene", ponies[i].sceneName.toLower());
+            xmlWriter.writeTextElement("scene", ponies[i].sceneName());
 
             // write inventory
             xmlWriter.writeTextElement("bits", QString::number(ponies[i].nBits));
@@ -250,7 +250,7 @@ QList<Pony> Player::loadPonies(Player* player)
         Pony pony{player};
         pony.ponyData = QByteArray::fromBase64(DomPonyData.text().toUtf8());
         pony.name = dataToString(pony.ponyData);
-        pony.sceneName = DomScene.text();
+        pony.sceneId = findSceneId(DomScene.text());
 
         pony.pos.x = DomPos.attribute("x").toFloat();
         pony.pos.y = DomPos.attribute("y").toFloat();
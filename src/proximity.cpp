@@ -0,0 +1,135 @@
+#include "proximity.h"
+#include "scene.h"
+#include "player.h"
+#include "entityStore.h"
+#include <QtAlgorithms>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROXIMITY_SSE
+#include <emmintrin.h>
+#endif
+
+#define PROXIMITY_FAR 1e18f // Coordinate of the padding, never within any radius
+
+thread_local QVector<Player*> Proximity::candidates;
+thread_local QVector<float> Proximity::playerX, Proximity::playerZ;
+
+void Proximity::inRadius(const EntityStore& store, const UVector& pos, float radius, quint8 flags, QVector<int>& result)
+{
+    int count = store.size();
+    const float* xs = store.x.constData();
+    const float* zs = store.z.constData();
+    float radius2 = radius * radius;
+    int i = 0;
+
+#ifdef PROXIMITY_SSE
+    const __m128 px = _mm_set1_ps(pos.x), pz = _mm_set1_ps(pos.z), r2 = _mm_set1_ps(radius2);
+    for (; i+4 <= count; i+=4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs+i), px);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(zs+i), pz);
+        int inside = _mm_movemask_ps(_mm_cmple_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), r2));
+        for (; inside; inside &= inside-1)
+        {
+            int j = i + qCountTrailingZeroBits((quint32)inside);
+            if ((store.flags[j] & flags) && !(store.flags[j] & EntityStore::Dead))
+                result << j;
+        }
+    }
+#endif
+
+    // What's left after the batches of 4, or everything without SSE
+    for (; i<count; i++)
+    {
+        float dx = xs[i] - pos.x;
+        float dz = zs[i] - pos.z;
+        if (dx*dx + dz*dz <= radius2 && (store.flags[i] & flags) && !(store.flags[i] & EntityStore::Dead))
+            result << i;
+    }
+}
+
+void Proximity::nearestPlayers(const Scene& scene, const QVector<UVector>& points, const QVector<float>& radii,
+                               QVector<Player*>& result)
+{
+    int nPoints = points.size();
+    result.fill(nullptr, nPoints);
+    if (!nPoints || scene.players.isEmpty())
+        return;
+
+    // One grid query for the whole batch, around the box of the points
+    float minX = FLT_MAX, maxX = -FLT_MAX, minZ = FLT_MAX, maxZ = -FLT_MAX, maxRadius = 0;
+    for (int i=0; i<nPoints; i++)
+    {
+        minX = qMin(minX, points[i].x);
+        maxX = qMax(maxX, points[i].x);
+        minZ = qMin(minZ, points[i].z);
+        maxZ = qMax(maxZ, points[i].z);
+        maxRadius = qMax(maxRadius, radii[i]);
+    }
+    UVector center((minX+maxX)/2, 0, (minZ+maxZ)/2);
+    float halfX = (maxX-minX)/2, halfZ = (maxZ-minZ)/2;
+    candidates.clear();
+    scene.grid.query(center, sqrt(halfX*halfX + halfZ*halfZ) + maxRadius, candidates);
+
+    // Pack the ponies that can be attacked
+    int count = 0;
+    for (Player* player : candidates)
+        if (player->inGame >= 3 && !player->pony.dead)
+            candidates[count++] = player;
+    candidates.resize(count);
+    if (!count)
+        return;
+    int padded = (count + 3) & ~3;
+    playerX.resize(padded);
+    playerZ.resize(padded);
+    for (int i=0; i<padded; i++)
+    {
+        playerX[i] = i < count ? candidates[i]->pony.pos.x : PROXIMITY_FAR;
+        playerZ[i] = i < count ? candidates[i]->pony.pos.z : PROXIMITY_FAR;
+    }
+
+    for (int p=0; p<nPoints; p++)
+    {
+        float radius2 = radii[p] * radii[p];
+        if (radius2 <= 0)
+            continue;
+        float nearest2 = radius2;
+#ifdef PROXIMITY_SSE
+        const __m128 px = _mm_set1_ps(points[p].x), pz = _mm_set1_ps(points[p].z), r2 = _mm_set1_ps(radius2);
+        for (int i=0; i<padded; i+=4)
+        {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(&playerX[i]), px);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(&playerZ[i]), pz);
+            __m128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+            int inside = _mm_movemask_ps(_mm_cmple_ps(dist2, r2));
+            if (!inside) // Most mobs have nopony around
+                continue;
+            float d2[4];
+            _mm_storeu_ps(d2, dist2);
+            for (; inside; inside &= inside-1)
+            {
+                int j = qCountTrailingZeroBits((quint32)inside);
+                if (d2[j] <= nearest2)
+                {
+                    nearest2 = d2[j];
+                    result[p] = candidates[i+j];
+                }
+            }
+        }
+#else
+        for (int i=0; i<count; i++)
+        {
+            float dx = playerX[i] - points[p].x;
+            float dz = playerZ[i] - points[p].z;
+            float dist2 = dx*dx + dz*dz;
+            if (dist2 <= nearest2)
+            {
+                nearest2 = dist2;
+                result[p] = candidates[i];
+            }
+        }
+#endif
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef PROXIMITY_H
+#define PROXIMITY_H
+
+#include <QVector>
+#include "dataType.h"
+
+class Scene;
+class Player;
+class EntityStore;
+
+/// Distance queries between the entities of a scene, on the horizontal (x,z) plane.
+/// The positions are packed as structure of arrays and tested 4 at a time,
+/// the scene's spatial grid narrows the players down before that.
+class Proximity
+{
+public:
+    /// Appends to result the index in store of the entities within radius of pos,
+    /// that have one of these EntityStore flags and aren't dead
+    static void inRadius(const EntityStore& store, const UVector& pos, float radius, quint8 flags, QVector<int>& result);
+
+    /// For each point, the nearest player of the scene within its radius, or nullptr.
+    /// Only the players in game and alive count. Used for the aggro of a batch of mobs
+    static void nearestPlayers(const Scene& scene, const QVector<UVector>& points, const QVector<float>& radii,
+                               QVector<Player*>& result);
+
+private:
+    // The players near the batch, as structure of arrays padded to a multiple of 4, like MoveValidation's batches.
+    // One copy per thread, the scene jobs query in parallel
+    static thread_local QVector<Player*> candidates;
+    static thread_local QVector<float> playerX, playerZ;
+};
+
+#endif // PROXIMITY_H
@@ -44,7 +44,11 @@ Quest::Quest(QString path, Player *Owner)
             else throw QString(QObject::tr("Quest::Quest: Error reading name, quest %1").arg(path));
         else if (line[0] == "scene")
             if (line.size()>=2)
-                npc->sceneName = lines[i].mid(line[0].size()+1).toLower();
+            {
+                npc->sceneId = findSceneId(lines[i].mid(line[0].size()+1));
+                if (npc->sceneId == INVALID_SCENE_ID)
+                    throw QString(QObject::tr("Quest::Quest: Unknown scene %1, quest %2").arg(lines[i].mid(line[0].size()+1)).arg(path));
+            }
             else throw QString(QObject::tr("Quest::Quest: Error reading scene, quest %1").arg(path));
         else if (line[0] == "ponyData")
         {
@@ -106,10 +110,8 @@ Quest::Quest(QString path, Player *Owner)
             {
                 id = line[1].toInt();
 
-                SceneEntity::lastIdMutex.lock();
                 npc->id = 0;
-                npc->netviewId = id;
-                SceneEntity::lastIdMutex.unlock();
+                npc->netviewId = id; // Reserved when the NPC is added to the server
             }
             else throw QString(QObject::tr("Quest::Quest: Error reading questId, quest %1").arg(path));
         else if (line[0] == "questName")
@@ -5,6 +5,9 @@
 #include "app.h"
 #include "log.h"
 #include "scene.h"
+#include "serverTick.h"
+#include "netviewIndex.h"
+#include "sceneLoadQueue.h"
 
 void receiveChatMessage(QByteArray msg, Player* player)
 {
@@ -32,7 +35,7 @@ void receiveChatMessage(QByteArray msg, Player* player)
 
     if (messages[0].startsWith("/stuck") || messages[0].startsWith("unstuck me")) // "/stuck" is sent as "unstuck me" from client
     {
-        sendLoadSceneRPC(player, player->pony.sceneName);
+        ServerTick::post(player, [player](){SceneLoadQueue::load(player, player->pony.sceneId);});
         return;
     }
 
@@ -51,7 +54,7 @@ void receiveChatMessage(QByteArray msg, Player* player)
                 {
                     playersInGame += Scene::scenes[i].players.count();
                     namesmsg2 += QString("<br /><span color=\"yellow\">%1 (%2 Players):</span>")
-                            .arg(Scene::scenes[i].name).arg(Scene::scenes[i].players.count());
+                            .arg(Scene::scenes[i].displayName()).arg(Scene::scenes[i].players.count());
                     for (int p=0; p<Scene::scenes[i].players.count(); p++)
                     {
                         namesmsg2 += "<br />" + Scene::scenes[i].players[p]->pony.name;
@@ -69,7 +72,7 @@ void receiveChatMessage(QByteArray msg, Player* player)
 //                    if (player->accessLvl >= 3)
 //                        namesmsg2 += " (" + Player::udpPlayers[i]->name + ")";
 //                    namesmsg2 += "#b<br /><span color=\"yellow\"> - in "
-//                                + Player::udpPlayers[i]->pony.sceneName + "</span>";
+//                                + Player::udpPlayers[i]->pony.sceneName() + "</span>";
 //                }
 
             QString namesmsg = QString("<span color=\"yellow\">%1 Players currently in game:</span>").arg(playersInGame);
@@ -87,7 +90,8 @@ void receiveChatMessage(QByteArray msg, Player* player)
               QString msgtosend = ":tp<br /><span color=\"yellow\">Usage:</span><br /><em>:tp location</em><br /><span color=\"yellow\">Available locations:</span><em>";
 
                 for (int i=0; i<Scene::scenes.size(); i++)
-                    msgtosend += "<br />" + Scene::scenes[i].name;
+                    if (Scene::scenes[i].instance == 0)
+                        msgtosend += "<br />" + Scene::scenes[i].name;
 
                 sendChatMessage(player, msgtosend + "</em>", "[Server]", channel, accessServer);
             }
@@ -95,15 +99,60 @@ void receiveChatMessage(QByteArray msg, Player* player)
             {
                 QString scene = messages[0].remove(0, 4);
 
-                if (sendLoadSceneRPC(player, scene))
+                ServerTick::post(player, [=]()
                 {
-                    sendChatMessage(player, QObject::tr("<span color=\"yellow\">teleporting to %1</span>").arg(scene), "[Server]", channel, accessServer); //show our command to us
-                }
-                else
+                    if (SceneLoadQueue::load(player, scene))
+                    {
+                        sendChatMessage(player, QObject::tr("<span color=\"yellow\">teleporting to %1</span>").arg(scene), "[Server]", channel, accessServer); //show our command to us
+                    }
+                    else
+                    {
+                        sendChatMessage(player, QObject::tr("<span color=\"yellow\">teleporting to %1 failed</span>").arg(scene), "[Server]", channel, accessServer); //show our command to us
+                    }
+                });
+            }
+            return;
+        }
+
+        // follow a friend into his instance of a scene
+        if (messages[0].startsWith(":join", Qt::CaseInsensitive))
+        {
+            QString name = messages[0].section(" ", 1).toLower().remove(" ");
+            if (name.length() < 3)
+            {
+                sendChatMessage(player, ":join<br /><span color=\"yellow\">Usage:</span><br /><em>:join player</em><br /><span color=\"yellow\">Goes to the instance of the scene where this player is.</span>", "[Server]", channel, accessServer);
+                return;
+            }
+
+            Player* friendPlayer = nullptr;
+            for (int i=0; i<Player::udpPlayers.size(); i++)
+            {
+                if (Player::udpPlayers[i]->inGame>=2 && Player::udpPlayers[i] != player
+                        && Player::udpPlayers[i]->pony.name.toLower().remove(" ").startsWith(name))
                 {
-                    sendChatMessage(player, QObject::tr("<span color=\"yellow\">teleporting to %1 failed</span>").arg(scene), "[Server]", channel, accessServer); //show our command to us
+                    friendPlayer = Player::udpPlayers[i];
+                    break;
                 }
             }
+            if (!friendPlayer || !friendPlayer->pony.scene)
+            {
+                sendChatMessage(player, QString("<span color=\"yellow\">player %1 not found</span>").arg(name), "[Server]", channel, accessServer);
+                return;
+            }
+
+            quint16 friendId = friendPlayer->pony.netviewId;
+            ServerTick::post(player, [=]()
+            {
+                if (NetviewIndex::findPlayer(friendId) != friendPlayer || !friendPlayer->pony.scene) // He left meanwhile
+                    return;
+                Scene* scene = friendPlayer->pony.scene;
+                if (scene == player->pony.scene)
+                    sendChatMessage(player, QObject::tr("<span color=\"yellow\">%1 is already here</span>").arg(friendPlayer->pony.name), "[Server]", channel, accessServer);
+                else if (scene->isFull())
+                    sendChatMessage(player, QObject::tr("<span color=\"yellow\">%1 is full</span>").arg(scene->displayName()), "[Server]", channel, accessServer);
+                else if (SceneLoadQueue::load(player, scene, friendPlayer->pony.pos, friendPlayer->pony.rot))
+                    sendChatMessage(player, QObject::tr("<span color=\"yellow\">joining %1 in %2</span>").arg(friendPlayer->pony.name).arg(scene->displayName()), "[Server]", channel, accessServer);
+            });
             return;
         }
 
@@ -179,7 +228,7 @@ void receiveChatMessage(QByteArray msg, Player* player)
             {
                 messages[0].remove(0, 3);
                 messages[0] = "<em>#b* " + author + "#b" + messages[0] + " *</em>";
-                sendChannelMessage(player->pony.sceneName, channel, messages[0], "", 0);
+                sendChannelMessage(player->pony.sceneId, channel, messages[0], "", 0);
             }
             return;
         }
@@ -202,7 +251,7 @@ void receiveChatMessage(QByteArray msg, Player* player)
                rollnum = qrand() % 100;
                rollstr.sprintf("<span color=\"yellow\">#b%s#b rolls %02d</span>", author.toLocal8Bit().data(), rollnum);
                player->chatRollCooldownEnd = QDateTime::currentDateTime().addSecs(10);
-               sendChannelMessage(player->pony.sceneName, channel, rollstr, "[Server]", accessServer);
+               sendChannelMessage(player->pony.sceneId, channel, rollstr, "[Server]", accessServer);
             }
             return;
         }
@@ -268,6 +317,6 @@ void receiveChatMessage(QByteArray msg, Player* player)
         }
         // normal message
         else
-            sendChannelMessage(player->pony.sceneName, channel, messages[0], author, accessLevel);
+            sendChannelMessage(player->pony.sceneId, channel, messages[0], author, accessLevel);
     }
 }
@@ -12,6 +12,10 @@
 #include "sceneEntity.h"
 #include "log.h"
 #include "settings.h"
+#include "rpc.h"
+#include "serverTick.h"
+#include "netviewIndex.h"
+#include "sceneLoadQueue.h"
 
 #define DEBUG_LOG false
 
@@ -137,6 +141,13 @@ void receiveMessage(Player* player)
 #if DEBUG_LOG
         //app.logMessage("UDP: Pong received");
 #endif
+        // Only the pong of our last ping gives a meaningful RTT
+        if (msg.size() >= 6 && (quint8)msg[5] == player->sentPingNumber && player->sentPingTime > 0)
+        {
+            float sample = timestampNow() - player->sentPingTime;
+            player->rtt = player->rtt > 0 ? player->rtt*0.875 + sample*0.125 : sample;
+            player->sentPingTime = 0;
+        }
     }
     else if ((unsigned char)msg[0] == MsgConnect) // Connect SYN
     {
@@ -179,17 +190,16 @@ void receiveMessage(Player* player)
             logMessage(QString("UDP: Starting game"));
     #endif
             // Set player id
-            SceneEntity::lastIdMutex.lock();
-            player->pony.id = SceneEntity::getNewId();
-            player->pony.netviewId = player->pony.id;
-            //player->pony.netviewId = SceneEntity::getNewNetviewId();
-            SceneEntity::lastIdMutex.unlock();
+            if (!player->pony.allocateId())
+            {
+                logError(QObject::tr("UDP: No free id left for %1, kicking").arg(player->name));
+                sendMessage(player,MsgDisconnect, "The server is full, sorry. You can try again later.");
+                Player::disconnectPlayerCleanup(player); // Save game and remove the player
+                return;
+            }
+            NetviewIndex::addPlayer(player->pony.netviewId, player);
             logMessage(QObject::tr("UDP: Set id request : %1/%2").arg(player->pony.id).arg(player->pony.netviewId));
-            QByteArray id(3,0); // Set player Id request
-            id[0]=4;
-            id[1]=(quint8)(player->pony.id&0xFF);
-            id[2]=(quint8)((player->pony.id>>8)&0xFF);
-            sendMessage(player,MsgUserReliableOrdered6,id);
+            sendMessage(player, SetPlayerIdRPC::channel, SetPlayerIdRPC::encode(player->pony.id)); // Set player Id request
 
             // Load characters screen request
             QByteArray data(1,5);
@@ -236,7 +246,7 @@ void receiveMessage(Player* player)
             // Fix the buggy state we're now in
             // Reload to hide the "saving ponies" message box
             QByteArray data(1,5);
-            data += stringToData(player->pony.sceneName);
+            data += stringToData(player->pony.sceneName());
             sendMessage(player,MsgUserReliableOrdered6,data);
             // Try to cancel the loading callbacks with inGame=1
             player->inGame = 1;
@@ -276,12 +286,12 @@ void receiveMessage(Player* player)
                 pony.ponyData = ponyData;
                 pony.name = ponyName;
 //                if (pony.getType() == Pony::Unicorn)
-//                    pony.sceneName = "canterlot";
+//                    pony.sceneId = findSceneId("canterlot");
 //                else if (pony.getType() == Pony::Pegasus)
-//                    pony.sceneName = "cloudsdale";
+//                    pony.sceneId = findSceneId("cloudsdale");
 //                else
-                pony.sceneName = "ponyville";
-                pony.pos = findVortex(pony.sceneName, 0).destPos;
+                pony.sceneId = findSceneId("ponyville");
+                pony.pos = findVortex(pony.sceneId, 0).destPos;
 
                 // create default inventory
                 pony.nBits = 15;
@@ -312,12 +322,24 @@ void receiveMessage(Player* player)
             }
             pony.id = player->pony.id;
             pony.netviewId = player->pony.netviewId;
+            pony.idGeneration = player->pony.idGeneration;
+            pony.scene = player->pony.scene;
+            pony.storeHandle = player->pony.storeHandle;
             player->pony = pony;
 
             Player::savePonies(player, ponies);
 
             // Send instantiate to the players of the new scene
-            sendLoadSceneRPC(player, player->pony.sceneName, player->pony.pos, player->pony.rot);
+            // A pony saved in a scene that was removed from the vortex DB starts again in Ponyville
+            if (!SceneLoadQueue::load(player, player->pony.sceneId, player->pony.pos, player->pony.rot)
+                    && !SceneLoadQueue::load(player, "ponyville"))
+            {
+                logError(QObject::tr("UDP: Kicking %1 (%2/%3): No scene to load")
+                         .arg(player->pony.netviewId).arg(player->name).arg(player->pony.name));
+                sendMessage(player,MsgDisconnect, "You were kicked, the server can't find your pony's scene. Please report this.");
+                Player::disconnectPlayerCleanup(player);
+                return;
+            }
 
             //Send the 46s init messages
             //app.logMessage(QString("UDP: Sending the 46 init messages"));
@@ -329,11 +351,16 @@ void receiveMessage(Player* player)
             if (player->inGame>=2)
             {
                 quint8 id = (quint8)msg[5];
-                Vortex vortex = findVortex(player->pony.sceneName, id);
-                if (vortex.destName.isEmpty())
-                    logError(QObject::tr("Can't find vortex %1 on map %2").arg(id).arg(player->pony.sceneName));
-                else
-                    sendLoadSceneRPC(player, vortex.destName, vortex.destPos, vortex.destRot);
+                const Vortex& vortex = findVortex(player->pony.sceneId, id);
+                if (vortex.destId == INVALID_SCENE_ID)
+                    logError(QObject::tr("Can't find vortex %1 on map %2").arg(id).arg(player->pony.sceneName()));
+                else // Moves the player across scenes, that's done between the scene jobs
+                {
+                    SceneId destId = vortex.destId;
+                    UVector destPos = vortex.destPos;
+                    UQuaternion destRot = vortex.destRot;
+                    ServerTick::post(player, [=](){SceneLoadQueue::load(player, destId, destPos, destRot);});
+                }
             }
         }
         else if ((unsigned char)msg[0]==MsgUserReliableOrdered4 && (unsigned char)msg[5]==0x2) // Delete pony request
@@ -350,8 +377,8 @@ void receiveMessage(Player* player)
         {
             //logMessage(QObject::tr("UDP: Broadcasting animation %1 from %2 (%3)").arg( QString(msg.mid(5, msgSize - 5).toHex())).arg(player->pony.id).arg(player->pony.name) );
             // Send to everyone
-            Scene* scene = findScene(player->pony.sceneName);
-            if (scene->name.isEmpty())
+            Scene* scene = player->pony.scene;
+            if (!scene)
                 logError(QObject::tr("UDP: Can't find the scene for animation message, aborting"));
             else
             {
@@ -371,7 +398,7 @@ void receiveMessage(Player* player)
                 }
             }
         }
-        else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x3D) // Skill
+        else if (SkillRPC::matches(msg)) // Skill
         {
 #if DEBUG_LOG
             app.logMessage("UDP: Broadcasting skill "+QString().setNum(dataToUint32(msg.mid(8))));
@@ -379,40 +406,59 @@ void receiveMessage(Player* player)
 
             bool skillOk=true;
             QByteArray reply;
-            uint32_t skillId = dataToUint32(msg.mid(8));
+            quint16 casterId;
+            quint32 skillId;
+            if (!SkillRPC::decode(msg, casterId, skillId))
+            {
+                logError(QObject::tr("UDP: Received a truncated skill message"));
+                return;
+            }
             if (skillId == 2) // Teleport is a special case
             {
-                if (msgSize == 28)
+                quint16 netviewId, targetNetId;
+                quint32 upgrade;
+                UVector pos;
+                if (msgSize == 28 && SkillPosRPC::decode(msg, netviewId, skillId, upgrade, pos))
                 {
                     reply += msg.mid(5, 7); // Netview, RPC, skill IDs
-                    reply += msg.mid(16, 4*3); // Pos X, Y, Z (floats)
+                    reply += floatToData(pos.x);
+                    reply += floatToData(pos.y);
+                    reply += floatToData(pos.z);
                     reply += uint32ToData(0); // Skill upgrade (0)
                     reply += floatToData(timestampNow());
+                    // The unicorn is allowed to be there now, the validation must not pull it back
+                    player->lastValidPos = pos;
+                    player->lastValidTime = timestampNow();
                 }
-                else if (msgSize == 18)
+                else if (msgSize == 18 && SkillTargetRPC::decode(msg, netviewId, skillId, upgrade, targetNetId))
                 {
-                    // Targeted teleport. First try to find the target in the udp players
-                    quint16 targetNetId = dataToUint16(msg.mid(16));
-                    Player* target = Player::findPlayer(Player::udpPlayers, targetNetId);
+                    // Targeted teleport, to a player or a NPC
+                    Player* target = NetviewIndex::findPlayer(targetNetId);
                     Pony* targetPony = nullptr;
-                    if (target->pony.netviewId == targetNetId && target->connected)
+                    if (target && target->connected)
                         targetPony = &target->pony;
                     else
-                    {
-                        // The target isn't a player. Check if it's a NPC
-                        for (Pony* npc : Quest::npcs)
-                            if (npc->netviewId == targetNetId)
-                                targetPony = npc;
-                    }
+                        targetPony = NetviewIndex::findNpc(targetNetId);
 
                     if (targetPony != nullptr)
                     {
-                        reply += msg.mid(5, 7);
-                        reply += floatToData(targetPony->pos.x);
-                        reply += floatToData(targetPony->pos.y);
-                        reply += floatToData(targetPony->pos.z);
-                        reply += uint32ToData(0); // Skill upgrade (0)
-                        reply += floatToData(timestampNow());
+                        // Teleport where the caster saw the target, one RTT ago
+                        UVector targetPos;
+                        UQuaternion targetRot;
+                        targetPony->rewind(timestampNow() - player->rtt, targetPos, targetRot);
+                        if (Skill::isInRange(skillId, 0, player->pony.pos, targetPos))
+                        {
+                            reply += msg.mid(5, 7);
+                            reply += floatToData(targetPos.x);
+                            reply += floatToData(targetPos.y);
+                            reply += floatToData(targetPos.z);
+                            reply += uint32ToData(0); // Skill upgrade (0)
+                            reply += floatToData(timestampNow());
+                            player->lastValidPos = targetPos;
+                            player->lastValidTime = timestampNow();
+                        }
+                        else
+                            logMessage(QObject::tr("UDP: Teleport target %1 out of range").arg(targetNetId));
                     }
                     else
                         logError(QObject::tr("UDP: Teleport target not found"));
@@ -422,26 +468,48 @@ void receiveMessage(Player* player)
             {
                 reply =  msg.mid(5, msgSize - 5);
 
-                if (msgSize == 18)
+                quint16 netviewId, targetNetId;
+                quint32 upgrade;
+                if (SkillTargetRPC::decode(msg, netviewId, skillId, upgrade, targetNetId) && msgSize == 18)
                 {
-                    // Targeted skill. First try to find the target in the mobs
-                    quint16 targetNetId = dataToUint16(msg.mid(16));
-                    for (Mob* mob : Mob::mobs)
+                    // The target is checked where the caster saw it, one RTT ago
+                    float castTime = timestampNow() - player->rtt;
+                    UVector targetPos;
+                    UQuaternion targetRot;
+
+                    // Targeted skill, on a mob or a player
+                    const NetviewRef& target = NetviewIndex::find(targetNetId);
+                    if (target.type == NetviewRef::MobEntity)
                     {
-                        if (mob->netviewId == targetNetId)
+                        Mob* mob = target.mob;
+                        mob->rewind(castTime, targetPos, targetRot);
+                        if (!mob->dead && Skill::isInRange(skillId, 0, player->pony.pos, targetPos))
                         {
                             skillOk = Skill::applySkill(skillId, *mob, SkillTarget::Enemy);
-                            break;
+                            if (skillOk)
+                                Skill::applySplash(skillId, 0, mob->scene, targetPos, mob);
                         }
+                        else
+                            skillOk = false;
+                    }
+                    else if (target.type != NetviewRef::PlayerPony)
+                    {
+                        logMessage(QObject::tr("UDP: Skill target %1 not found").arg(targetNetId));
+                        skillOk = false;
                     }
-
-                    Player* target = Player::findPlayer(Player::udpPlayers, targetNetId);
-                    if (target->pony.netviewId == player->pony.netviewId)
-                        skillOk = Skill::applySkill(skillId, target->pony, SkillTarget::Self);
-                    else if (Settings::enablePVP) // During PVP, all friendly ponies are now ennemies !
-                        skillOk = Skill::applySkill(skillId, target->pony, SkillTarget::Enemy);
                     else
-                        skillOk = Skill::applySkill(skillId, target->pony, SkillTarget::Friendly);
+                    {
+                        Player* targetPlayer = target.player;
+                        targetPlayer->pony.rewind(castTime, targetPos, targetRot);
+                        if (targetPlayer == player)
+                            skillOk = Skill::applySkill(skillId, targetPlayer->pony, SkillTarget::Self);
+                        else if (!Skill::isInRange(skillId, 0, player->pony.pos, targetPos))
+                            skillOk = false;
+                        else if (Settings::enablePVP) // During PVP, all friendly ponies are now ennemies !
+                            skillOk = Skill::applySkill(skillId, targetPlayer->pony, SkillTarget::Enemy);
+                        else
+                            skillOk = Skill::applySkill(skillId, targetPlayer->pony, SkillTarget::Friendly);
+                    }
                 }
 
                 // Apply animation
@@ -454,8 +522,10 @@ void receiveMessage(Player* player)
             }
 
             // Send to everyone
-            Scene* scene = findScene(player->pony.sceneName);
-            if (scene->name.isEmpty())
+            Scene* scene = player->pony.scene;
+            if (reply.isEmpty())
+                return;
+            else if (!scene)
                 logError(QObject::tr("UDP: Can't find the scene for skill message, aborting"));
             else
             {
@@ -467,8 +537,8 @@ void receiveMessage(Player* player)
         else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x08) // Wear request
         {
             quint8 index = msg[9];
-            Scene* scene = findScene(player->pony.sceneName);
-            if (scene->name.isEmpty())
+            Scene* scene = player->pony.scene;
+            if (!scene)
                 logError(QObject::tr("UDP: Can't find the scene for wear message, aborting"));
             else
             {
@@ -481,25 +551,19 @@ void receiveMessage(Player* player)
                 }
             }
         }
-        else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x16) // BeginShop request
+        else if (BeginShopRPC::matches(msg)) // BeginShop request
         {
             // BeginShop doesn't specify wich shop you want to buy from
             // We'll assume that there's never more than one shop per scene.
-            uint16_t netviewId = dataToUint16(msg.mid(5));
-            Pony* targetNpc = nullptr;
-            for (Pony* npc : Quest::npcs)
-            {
-                if (npc->netviewId == netviewId && npc->inv.size()) // Has a shop
-                {
-                    targetNpc = npc;
-                    break;
-                }
-            }
-            if (targetNpc)
+            quint16 netviewId;
+            if (!BeginShopRPC::decode(msg, netviewId))
+                return;
+            Pony* targetNpc = NetviewIndex::findNpc(netviewId);
+            if (targetNpc && targetNpc->inv.size()) // Has a shop
                 sendBeginShop(player, targetNpc);
             else
                 logError(QObject::tr("UDP: Can't find a shop on scene %1 for BeginShop")
-                               .arg(player->pony.sceneName));
+                               .arg(player->pony.sceneName()));
         }
         else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x17) // EndShop request
         {
@@ -508,8 +572,13 @@ void receiveMessage(Player* player)
         else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x0A) // BuyItem request
         {
             /// TODO: At the moment we don't actually pay for items, since there are no monsters.
-            uint16_t itemId = dataToUint32(msg.mid(8));
-            uint16_t amount = dataToUint32(msg.mid(12));
+            quint16 netviewId;
+            quint32 itemId, amount;
+            if (!BuyItemRPC::decode(msg, netviewId, itemId, amount))
+            {
+                logError(QObject::tr("UDP: Received a truncated BuyItem request"));
+                return;
+            }
 
             player->pony.addInventoryItem(itemId, amount);
             sendSetBitsRPC(player);
@@ -517,49 +586,50 @@ void receiveMessage(Player* player)
         else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x0B) // SellItem request
         {
             /// TODO: At the moment we don't actually pay for items, since there are no monsters.
-            uint16_t itemId = dataToUint32(msg.mid(8));
-            uint16_t amount = dataToUint32(msg.mid(12));
+            quint16 netviewId;
+            quint32 itemId, amount;
+            if (!SellItemRPC::decode(msg, netviewId, itemId, amount))
+            {
+                logError(QObject::tr("UDP: Received a truncated SellItem request"));
+                return;
+            }
 
             player->pony.removeInventoryItem(itemId, amount);
             sendSetBitsRPC(player);
         }
-        else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x04) // Get worn items request
+        else if (GetWornRPC::matches(msg)) // Get worn items request
         {
-            quint16 targetId = ((quint16)(quint8)msg[5]) + (((quint16)(quint8)msg[6])<<8);
-            Player* target = Player::findPlayer(Player::udpPlayers, targetId);
-            if (target->pony.netviewId == targetId && target->connected)
+            quint16 targetId;
+            if (!GetWornRPC::decode(msg, targetId))
+                return;
+            Player* target = NetviewIndex::findPlayer(targetId);
+            Pony* targetNpc = NetviewIndex::findNpc(targetId);
+            if (target && target->connected)
                 sendWornRPC(&target->pony, player, target->pony.worn);
+            else if (targetNpc)
+                sendWornRPC(targetNpc, player, targetNpc->worn);
             else
-            {
-                Pony* targetNpc = nullptr;
-                for (Pony* npc : Quest::npcs)
-                {
-                    if (npc->netviewId == targetId)
-                    {
-                        targetNpc = npc;
-                        break;
-                    }
-                }
-                if (targetNpc)
-                    sendWornRPC(targetNpc, player, targetNpc->worn);
-                else
-                    logError(QObject::tr("UDP: Can't find netviewId %1 to send worn items")
-                                   .arg(targetId));
-            }
+                logError(QObject::tr("UDP: Can't find netviewId %1 to send worn items")
+                               .arg(targetId));
         }
-        else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x09) // Unwear item request
+        else if (UnwearRequestRPC::matches(msg)) // Unwear item request
         {
-            quint16 targetId = ((quint16)(quint8)msg[5]) + (((quint16)(quint8)msg[6])<<8);
-            Player* target = Player::findPlayer(Player::udpPlayers, targetId);
-            if (target->pony.netviewId == targetId)
-                target->pony.unwearItemAt(dataToUint8(msg.mid(8)));
+            quint16 targetId;
+            quint8 slot;
+            if (!UnwearRequestRPC::decode(msg, targetId, slot))
+                return;
+            Player* target = NetviewIndex::findPlayer(targetId);
+            if (target)
+                target->pony.unwearItemAt(slot);
             else
                 logMessage(QObject::tr("UDP: Can't find netviewId %1 to unwear item")
                                .arg(targetId));
         }
-        else if ((unsigned char)msg[0]==MsgUserReliableOrdered11 && (unsigned char)msg[7]==0x31) // Run script (NPC) request
+        else if (RunScriptRPC::matches(msg)) // Run script (NPC) request
         {
-            quint16 targetId = ((quint16)(quint8)msg[5]) + (((quint16)(quint8)msg[6])<<8);
+            quint16 targetId;
+            if (!RunScriptRPC::decode(msg, targetId))
+                return;
             //app.logMessage("UDP: Quest "+QString().setNum(targetId)+" requested");
             for (int i=0; i<player->pony.quests.size(); i++)
                 if (player->pony.quests[i].id == targetId)
@@ -574,12 +644,11 @@ void receiveMessage(Player* player)
             //app.logMessage("UDP: Resuming script for quest "+QString().setNum(player->pony.lastQuest));
             player->pony.quests[player->pony.lastQuest].processAnswer();
         }
-        else if ((unsigned char)msg[0]==MsgUserReliableOrdered4 && (unsigned char)msg[5]==0xC) // Continue dialog (with answer)
+        else if (DialogAnswerRPC::matches(msg)) // Continue dialog (with answer)
         {
-            quint32 answer = ((quint32)(quint8)msg[6])
-                            + (((quint32)(quint8)msg[7])<<8)
-                            + (((quint32)(quint8)msg[8])<<16)
-                            + (((quint32)(quint8)msg[9])<<24);
+            quint32 answer;
+            if (!DialogAnswerRPC::decode(msg, answer))
+                return;
             //app.logMessage("UDP: Resuming script with answer "+QString().setNum(answer)
             //               +" for quest "+QString().setNum(player->pony.lastQuest));
             player->pony.quests[player->pony.lastQuest].processAnswer(answer);
@@ -589,13 +658,9 @@ void receiveMessage(Player* player)
             quint8 targetPlayerId = (quint8)msg[10];
             QString targetPlayer = "not found";
 
-            //get name
-            for (int i=0; i<Player::udpPlayers.size();i++)
-            {
-                if (Player::udpPlayers[i]->pony.id == targetPlayerId)
-                    targetPlayer = Player::udpPlayers[i]->name;
-
-            }
+            //get name, a player's pony id is its netviewId
+            if (Player* target = NetviewIndex::findPlayer(targetPlayerId))
+                targetPlayer = target->name;
 
             logMessage(QObject::tr("UDP: Friend request received : %1(%2) -> %3(%4)")
                        .arg(player->name)
@@ -611,13 +676,9 @@ void receiveMessage(Player* player)
             quint8 targetPlayerId = (quint8)msg[7];
             QString targetPlayer = "not found";
 
-            //get name
-            for (int i=0; i<Player::udpPlayers.size();i++)
-            {
-                if (Player::udpPlayers[i]->pony.id == targetPlayerId)
-                    targetPlayer = Player::udpPlayers[i]->name;
-
-            }
+            //get name, a player's pony id is its netviewId
+            if (Player* target = NetviewIndex::findPlayer(targetPlayerId))
+                targetPlayer = target->name;
 
             logMessage(QObject::tr("UDP: Player %1(%2) reported %3(%4):\n%5")
                        .arg(player->name)
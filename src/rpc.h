@@ -0,0 +1,251 @@
+#ifndef RPC_H
+#define RPC_H
+
+/**
+  This file describes the layout of the fixed-size RPCs.
+  Each RPC is declared once as a list of field types, the encoders and the
+  validating decoders are generated from that list at compile time.
+  Sizes are compile-time constants, so buffers are allocated once with their exact size.
+**/
+
+#include <cstring>
+#include <QByteArray>
+#include "dataType.h"
+#include "message.h"
+
+namespace Rpc
+{
+
+/// Wire format of a single field. Everything is little endian, like the rest of the protocol
+template <typename T> struct Field;
+
+template <> struct Field<quint8>
+{
+    enum : int { size = 1 };
+    static void write(char* out, quint8 value) { out[0] = (char)value; }
+    static void read(const char* in, quint8& value) { value = (quint8)in[0]; }
+};
+
+template <> struct Field<quint16>
+{
+    enum : int { size = 2 };
+    static void write(char* out, quint16 value)
+    {
+        out[0] = (char)(value&0xFF);
+        out[1] = (char)((value>>8)&0xFF);
+    }
+    static void read(const char* in, quint16& value)
+    {
+        value = (quint16)(quint8)in[0] + ((quint16)(quint8)in[1]<<8);
+    }
+};
+
+template <> struct Field<quint32>
+{
+    enum : int { size = 4 };
+    static void write(char* out, quint32 value)
+    {
+        out[0] = (char)(value&0xFF);
+        out[1] = (char)((value>>8)&0xFF);
+        out[2] = (char)((value>>16)&0xFF);
+        out[3] = (char)((value>>24)&0xFF);
+    }
+    static void read(const char* in, quint32& value)
+    {
+        value = (quint32)(quint8)in[0] + ((quint32)(quint8)in[1]<<8)
+                + ((quint32)(quint8)in[2]<<16) + ((quint32)(quint8)in[3]<<24);
+    }
+};
+
+template <> struct Field<float>
+{
+    enum : int { size = 4 };
+    static void write(char* out, float value) { memcpy(out, &value, 4); }
+    static void read(const char* in, float& value) { memcpy(&value, in, 4); }
+};
+
+template <> struct Field<UVector>
+{
+    enum : int { size = 12 };
+    static void write(char* out, UVector value)
+    {
+        Field<float>::write(out, value.x);
+        Field<float>::write(out+4, value.y);
+        Field<float>::write(out+8, value.z);
+    }
+    static void read(const char* in, UVector& value)
+    {
+        Field<float>::read(in, value.x);
+        Field<float>::read(in+4, value.y);
+        Field<float>::read(in+8, value.z);
+    }
+};
+
+template <> struct Field<UQuaternion>
+{
+    enum : int { size = 16 };
+    static void write(char* out, UQuaternion value)
+    {
+        Field<float>::write(out, value.x);
+        Field<float>::write(out+4, value.y);
+        Field<float>::write(out+8, value.z);
+        Field<float>::write(out+12, value.w);
+    }
+    static void read(const char* in, UQuaternion& value)
+    {
+        Field<float>::read(in, value.x);
+        Field<float>::read(in+4, value.y);
+        Field<float>::read(in+8, value.z);
+        Field<float>::read(in+12, value.w);
+    }
+};
+
+/// A sequence of fields, written back to back
+template <typename... Fields> struct Layout;
+
+template <> struct Layout<>
+{
+    enum : int { size = 0 };
+    static void write(char*) {}
+    static void read(const char*) {}
+};
+
+template <typename F, typename... Rest> struct Layout<F, Rest...>
+{
+    enum : int { size = Field<F>::size + Layout<Rest...>::size };
+    static void write(char* out, F value, Rest... rest)
+    {
+        Field<F>::write(out, value);
+        Layout<Rest...>::write(out+Field<F>::size, rest...);
+    }
+    static void read(const char* in, F& value, Rest&... rest)
+    {
+        Field<F>::read(in, value);
+        Layout<Rest...>::read(in+Field<F>::size, rest...);
+    }
+};
+
+/// Appends the fields of layout L at the end of data, for RPCs that also carry variable-size fields
+template <typename L, typename... Args> void append(QByteArray& data, Args... args)
+{
+    int offset = data.size();
+    data.resize(offset + L::size);
+    L::write(data.data()+offset, args...);
+}
+
+/// Finds the payload of a received message, bounded by the length in its header.
+/// Returns false if the message is truncated
+inline bool messagePayload(const QByteArray& msg, const char*& payload, int& payloadSize)
+{
+    if (msg.size() < 5)
+        return false;
+    payloadSize = (((quint8)msg[3]) + (((quint8)msg[4]) << 8)) / 8;
+    if (msg.size() < 5 + payloadSize)
+        return false;
+    payload = msg.constData() + 5;
+    return true;
+}
+
+/// RPC addressed to a netview : netviewId, RPC id, arguments
+template <quint8 Channel, quint8 Id, typename... Args> struct NetviewRpc
+{
+    typedef Layout<quint16, quint8, Args...> Wire;
+    enum : quint8 { channel = Channel, id = Id };
+    enum : int { size = Wire::size };
+
+    static QByteArray encode(quint16 netviewId, Args... args)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        Wire::write(data.data(), netviewId, Id, args...);
+        return data;
+    }
+
+    /// Whether the received message is on our channel with our RPC id
+    static bool matches(const QByteArray& msg)
+    {
+        return msg.size() >= 8 && (quint8)msg[0] == Channel && (quint8)msg[7] == Id;
+    }
+
+    /// Decodes a received message. Returns false if it isn't this RPC or if it's too short.
+    /// Trailing data is allowed, so a longer variant of the RPC can be decoded as its prefix
+    static bool decode(const QByteArray& msg, quint16& netviewId, Args&... args)
+    {
+        const char* payload;
+        int payloadSize;
+        if (!matches(msg) || !messagePayload(msg, payload, payloadSize) || payloadSize < size)
+            return false;
+        quint8 rpcId;
+        Wire::read(payload, netviewId, rpcId, args...);
+        return true;
+    }
+};
+
+/// RPC that isn't addressed to a netview : RPC id, arguments
+template <quint8 Channel, quint8 Id, typename... Args> struct GlobalRpc
+{
+    typedef Layout<quint8, Args...> Wire;
+    enum : quint8 { channel = Channel, id = Id };
+    enum : int { size = Wire::size };
+
+    static QByteArray encode(Args... args)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        Wire::write(data.data(), Id, args...);
+        return data;
+    }
+
+    static bool matches(const QByteArray& msg)
+    {
+        return msg.size() >= 6 && (quint8)msg[0] == Channel && (quint8)msg[5] == Id;
+    }
+
+    static bool decode(const QByteArray& msg, Args&... args)
+    {
+        const char* payload;
+        int payloadSize;
+        if (!matches(msg) || !messagePayload(msg, payload, payloadSize) || payloadSize < size)
+            return false;
+        quint8 rpcId;
+        Wire::read(payload, rpcId, args...);
+        return true;
+    }
+};
+
+}
+
+/// Stats, inventory and worn items (sent)
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x32, quint8, float> SetStatRPC; // statId, value
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x33, quint8, float> SetMaxStatRPC; // statId, value
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x06, quint32, quint32, quint32> AddItemRPC; // itemId, amount, index
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x07, quint8, quint32> DeleteItemRPC; // index, amount
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x08, quint32, quint8> WearItemRPC; // itemId, index
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x09, quint8> UnwearItemRPC; // slot
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x10, quint32> SetBitsRPC; // nBits
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered18, 0x17> EndShopRPC;
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered12, 0xCA, quint32> AnimationRPC; // animationId
+
+/// Netview requests (received)
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x3D, quint32> SkillRPC; // skillId
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x3D, quint32, quint32, quint16> SkillTargetRPC; // skillId, upgrade, target netviewId
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x3D, quint32, quint32, UVector> SkillPosRPC; // skillId, upgrade, target pos
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x04> GetWornRPC;
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x09, quint8> UnwearRequestRPC; // slot
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x0A, quint32, quint32> BuyItemRPC; // itemId, amount
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x0B, quint32, quint32> SellItemRPC; // itemId, amount
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x16> BeginShopRPC;
+typedef Rpc::NetviewRpc<MsgUserReliableOrdered11, 0x31> RunScriptRPC;
+
+/// Global RPCs
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered6, 0x02, quint16> NetviewRemoveRPC; // netviewId
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered6, 0x02, quint16, quint8> NetviewRemoveReasonRPC; // netviewId, reason code
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered6, 0x04, quint16> SetPlayerIdRPC; // playerId
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered4, 0x0B> BeginDialogRPC;
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered4, 0x0C, quint32> DialogAnswerRPC; // answer
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered4, 0x0D> EndDialogRPC;
+typedef Rpc::GlobalRpc<MsgUserReliableOrdered4, 0xCE, UVector> MoveRPC; // pos
+
+/// Fixed-size parts of the RPCs with variable-size fields
+typedef Rpc::Layout<quint16, quint16, UVector, UQuaternion> InstantiateLayout; // netviewId, viewId, pos, rot (after the key)
+typedef Rpc::Layout<quint16, quint16, quint8> ChatSenderLayout; // netviewId, ponyId, accessLevel (after the message)
+
+#endif // RPC_H
@@ -1,14 +1,24 @@
 #include "scene.h"
 #include "log.h"
+#include "sync.h"
+#include "player.h"
+#include "mob.h"
+#include "mobzone.h"
+#include "settings.h"
+#include "netviewIndex.h"
+#include "skill.h"
 #include <QFile>
+#include <cstring>
 #include <QtXml/qdom.h>
 
 QList<Scene> Scene::scenes; // List of scenes from the vortex DB
+QHash<QString, SceneId> Scene::ids; // Id of each scene by lowercase name
 
 Vortex::Vortex()
 {
     id = 0;
     destName = QString();
+    destId = INVALID_SCENE_ID;
     destPos = UVector();
     destRot = UQuaternion();
 }
@@ -16,7 +26,95 @@ Vortex::Vortex()
 Scene::Scene(QString sceneName)
 {
     name = sceneName.toLower();
+    id = INVALID_SCENE_ID;
+    baseId = INVALID_SCENE_ID;
+    instance = 0;
+    maxPlayers = 0;
     vortexes = QList<Vortex>();
+    quantizedSync = false;
+    boundsMin = UVector(XMIN, YMIN, ZMIN);
+    boundsMax = UVector(XMAX, YMAX, ZMAX);
+    syncNearRadius = syncMidRadius = -1;
+    syncMidInterval = syncFarInterval = 0;
+    nSpeedViolations = nHeightViolations = nBoundsViolations = 0;
+    entitiesVersion = entityListVersion = 0;
+    entityListTime = 0;
+    nextMobAI = 0;
+    for (int i=0; i<256; i++)
+        vortexIndex[i] = -1;
+}
+
+void Scene::addPlayer(Player* player)
+{
+    entitiesVersion++;
+    players << player;
+    grid.insert(player, player->pony.pos);
+    player->pony.scene = this;
+    player->pony.storeHandle = entities.add(&player->pony, EntityStore::PlayerEntity, player->pony.health);
+}
+
+void Scene::removePlayer(Player* player)
+{
+    entitiesVersion++;
+    players.removeAll(player);
+    grid.remove(player);
+    movedPlayers.removeOne(player);
+    player->pendingValidation = false;
+    if (player->pony.scene == this)
+    {
+        entities.remove(player->pony.storeHandle);
+        player->pony.storeHandle = INVALID_ENTITY_HANDLE;
+        player->pony.scene = nullptr;
+    }
+}
+
+void Scene::addNpc(Pony* npc)
+{
+    entitiesVersion++;
+    npcs << npc;
+    npc->scene = this;
+    npc->storeHandle = entities.add(npc, EntityStore::NpcEntity, npc->health);
+}
+
+void Scene::addMob(Mob* mob)
+{
+    entitiesVersion++;
+    mobs << mob;
+    mob->scene = this;
+    mob->storeHandle = entities.add(mob, EntityStore::MobEntity, mob->health);
+}
+
+bool Scene::addVortex(const Vortex& vortex)
+{
+    if (vortexIndex[vortex.id] >= 0)
+        return false;
+    vortexIndex[vortex.id] = vortexes.size();
+    vortexes << vortex;
+    return true;
+}
+
+void Scene::clearNpcs()
+{
+    entitiesVersion++;
+    for (Pony* npc : npcs)
+    {
+        entities.remove(npc->storeHandle);
+        npc->storeHandle = INVALID_ENTITY_HANDLE;
+        npc->scene = nullptr;
+    }
+    npcs.clear();
+}
+
+void Scene::clearEntities()
+{
+    clearNpcs();
+    for (Mob* mob : mobs)
+    {
+        entities.remove(mob->storeHandle);
+        mob->storeHandle = INVALID_ENTITY_HANDLE;
+        mob->scene = nullptr;
+    }
+    mobs.clear();
 }
 
 bool ReadVortxXml(QString file)
@@ -51,10 +149,67 @@ bool ReadVortxXml(QString file)
     }
     Scene scene(nodeScene.attribute("name"));
 
+    // Optional position bounds, enables the quantized sync on this scene
+    // <bounds xmin="-2500" ymin="-1000" zmin="-2500" xmax="2500" ymax="2500" zmax="2500"/>
+    QDomElement nodeBounds = nodeScene.firstChildElement("bounds");
+    if (!nodeBounds.isNull())
+    {
+        bool okMinX, okMinY, okMinZ, okMaxX, okMaxY, okMaxZ;
+        scene.boundsMin.x = nodeBounds.attribute("xmin",QString().setNum(XMIN)).toFloat(&okMinX);
+        scene.boundsMin.y = nodeBounds.attribute("ymin",QString().setNum(YMIN)).toFloat(&okMinY);
+        scene.boundsMin.z = nodeBounds.attribute("zmin",QString().setNum(ZMIN)).toFloat(&okMinZ);
+        scene.boundsMax.x = nodeBounds.attribute("xmax",QString().setNum(XMAX)).toFloat(&okMaxX);
+        scene.boundsMax.y = nodeBounds.attribute("ymax",QString().setNum(YMAX)).toFloat(&okMaxY);
+        scene.boundsMax.z = nodeBounds.attribute("zmax",QString().setNum(ZMAX)).toFloat(&okMaxZ);
+
+        if (!(okMinX && okMinY && okMinZ && okMaxX && okMaxY && okMaxZ)
+                || scene.boundsMin.x >= scene.boundsMax.x
+                || scene.boundsMin.y >= scene.boundsMax.y
+                || scene.boundsMin.z >= scene.boundsMax.z)
+        {
+            logStatusError(QObject::tr("Error parsing %1. Can't convert bounds data").arg(file));
+            return false;
+        }
+        scene.quantizedSync = nodeBounds.attribute("quantized","true") != "false";
+    }
+
+    // Optional sync level of detail, the missing attributes use the server's settings
+    // <sync nearRadius="60" midRadius="150" midInterval="3" farInterval="10"/>
+    QDomElement nodeSync = nodeScene.firstChildElement("sync");
+    if (!nodeSync.isNull())
+    {
+        bool okNear, okMid, okMidInterval, okFarInterval;
+        scene.syncNearRadius = nodeSync.attribute("nearRadius","-1").toFloat(&okNear);
+        scene.syncMidRadius = nodeSync.attribute("midRadius","-1").toFloat(&okMid);
+        scene.syncMidInterval = nodeSync.attribute("midInterval","0").toInt(&okMidInterval);
+        scene.syncFarInterval = nodeSync.attribute("farInterval","0").toInt(&okFarInterval);
+        if (!(okNear && okMid && okMidInterval && okFarInterval))
+        {
+            logStatusError(QObject::tr("Error parsing %1. Can't convert sync data").arg(file));
+            return false;
+        }
+    }
+
+    // Optional player cap, past it the new players go to another instance of the scene
+    // <instances maxPlayers="100"/>
+    QDomElement nodeInstances = nodeScene.firstChildElement("instances");
+    if (!nodeInstances.isNull())
+    {
+        bool okMaxPlayers;
+        scene.maxPlayers = nodeInstances.attribute("maxPlayers","0").toInt(&okMaxPlayers);
+        if (!okMaxPlayers)
+        {
+            logStatusError(QObject::tr("Error parsing %1. Can't convert instances data").arg(file));
+            return false;
+        }
+    }
+
     QDomNodeList nodeListVortex = nodeListScene.item(0).childNodes();
     for (int i = 0; i < nodeListVortex.size(); i++)
     {
         QDomNode n = nodeListVortex.item(i);
+        if (n.nodeName() != "vortex")
+            continue;
 
         QDomElement nodeVortexId = n.firstChildElement("id");
         QDomElement nodeVortexDestName = n.firstChildElement("name");
@@ -77,7 +232,8 @@ bool ReadVortxXml(QString file)
 
         if (okId && okPosX && okPosY && okPosZ && okRotX && okRotY && okRotZ && okRotW)
         {
-           scene.vortexes << vortex;
+            if (!scene.addVortex(vortex)) // The first one wins, like when we searched the list
+                logError(QObject::tr("Error parsing %1. Vortex %2 is defined twice").arg(file).arg(vortex.id));
         }
         else
         {
@@ -86,39 +242,218 @@ bool ReadVortxXml(QString file)
         }
     }
 
-    Scene::scenes << scene;
+    // Intern the name. A scene we already know (the server restarted) keeps its id
+    SceneId id = findSceneId(scene.name);
+    if (id != INVALID_SCENE_ID)
+    {
+        scene.id = scene.baseId = id;
+        scene.instances << id;
+        Scene::scenes[id] = scene;
+    }
+    else if (Scene::scenes.size() >= INVALID_SCENE_ID)
+    {
+        logStatusError(QObject::tr("Error parsing %1. Too many scenes").arg(file));
+        return false;
+    }
+    else
+    {
+        scene.id = scene.baseId = Scene::scenes.size();
+        scene.instances << scene.id;
+        Scene::ids.insert(scene.name, scene.id);
+        Scene::scenes << scene;
+    }
     xmlfile.close();
     return true;
 }
 
-Scene* findScene(QString sceneName)
+void linkVortexes()
 {
     for (int i=0; i<Scene::scenes.size(); i++)
-        if (Scene::scenes[i].name.toLower() == sceneName.toLower())
-            return &Scene::scenes[i];
+    {
+        for (Vortex& vortex : Scene::scenes[i].vortexes)
+        {
+            vortex.destId = findSceneId(vortex.destName);
+            if (vortex.destId == INVALID_SCENE_ID)
+                logError(QObject::tr("Vortex %1 of scene %2 leads to unknown scene %3")
+                         .arg(vortex.id).arg(Scene::scenes[i].name).arg(vortex.destName));
+        }
+    }
+}
+
+QString Scene::displayName() const
+{
+    if (!instance)
+        return name;
+    return name+" #"+QString().setNum(instance+1);
+}
 
-    return new Scene("");
+bool Scene::isFull() const
+{
+    int cap = maxPlayers ? maxPlayers : Settings::maxScenePlayers;
+    return cap > 0 && players.size() >= cap;
 }
 
-Vortex findVortex(QString sceneName, quint8 id)
+Scene* pickSceneInstance(SceneId sceneId, Player* player)
 {
-    Scene scene(sceneName);
+    Scene* scene = findScene(sceneId);
+    if (!scene)
+        return nullptr;
+    Scene& base = Scene::scenes[scene->baseId];
+
+    // Already in this scene (respawn, /stuck, ...), don't split him from the ponies around him
+    Scene* current = player->pony.scene;
+    if (current && current->baseId == base.id)
+        return current;
+
+    Scene* best = nullptr;
+    for (SceneId id : base.instances)
+    {
+        Scene& instance = Scene::scenes[id];
+        if (!instance.isFull() && (!best || instance.players.size() < best->players.size()))
+            best = &instance;
+    }
+    if (!best)
+        best = createSceneInstance(base.id);
+    return best ? best : &base; // Can't open more instances, overfill the original
+}
+
+void copyInstanceNpcs(const Scene& base, Scene& instance)
+{
+    // The NPCs don't change, the copies keep the netviewId of the original (its questId)
+    for (Pony* npc : base.npcs)
+    {
+        Pony* copy = new Pony(*npc);
+        copy->sceneId = instance.id;
+        copy->scene = nullptr;
+        copy->storeHandle = INVALID_ENTITY_HANDLE;
+        instance.addNpc(copy);
+    }
+}
+
+Scene* createSceneInstance(SceneId baseId)
+{
+    if (Scene::scenes.size() >= INVALID_SCENE_ID)
+    {
+        logError(QObject::tr("Can't open another instance of %1, too many scenes").arg(Scene::scenes[baseId].name));
+        return nullptr;
+    }
+
+    // Same configuration, but its own players, entities and sync
+    const Scene& original = Scene::scenes[baseId];
+    Scene instance(original.name);
+    instance.id = Scene::scenes.size();
+    instance.baseId = baseId;
+    instance.instance = original.instances.size();
+    instance.maxPlayers = original.maxPlayers;
+    instance.vortexes = original.vortexes;
+    memcpy(instance.vortexIndex, original.vortexIndex, sizeof(instance.vortexIndex));
+    instance.quantizedSync = original.quantizedSync;
+    instance.boundsMin = original.boundsMin;
+    instance.boundsMax = original.boundsMax;
+    instance.syncNearRadius = original.syncNearRadius;
+    instance.syncMidRadius = original.syncMidRadius;
+    instance.syncMidInterval = original.syncMidInterval;
+    instance.syncFarInterval = original.syncFarInterval;
+    Scene::scenes << instance;
+
+    Scene& base = Scene::scenes[baseId];
+    Scene& scene = Scene::scenes.last();
+    base.instances << scene.id;
+
+    copyInstanceNpcs(base, scene);
+
+    // The mobs fight, each copy is a new entity
+    for (Mob* mob : base.mobs)
+    {
+        Mob* copy = new Mob(*mob);
+        if (!copy->allocateId())
+        {
+            logError(QObject::tr("No free netviewId left for the mobs of %1").arg(scene.displayName()));
+            delete copy;
+            break;
+        }
+        copy->sceneId = scene.id;
+        copy->scene = nullptr;
+        copy->storeHandle = INVALID_ENTITY_HANDLE;
+        scene.addMob(copy);
+        copy->respawn();
+        Mob::mobs << copy;
+        copy->zone()->mobs << copy;
+        NetviewIndex::addMob(copy->netviewId, copy);
+    }
+
+    logMessage(QObject::tr("Opened scene instance %1").arg(scene.displayName()));
+    return &scene;
+}
+
+void removeSceneInstances()
+{
+    bool removed = false;
+    for (int i=Scene::scenes.size()-1; i>=0; i--)
+    {
+        Scene& scene = Scene::scenes[i];
+        if (scene.id == scene.baseId)
+            continue;
+        for (Pony* npc : scene.npcs)
+            delete npc;
+        for (Mob* mob : scene.mobs)
+        {
+            Skill::cancelEffects(mob);
+            NetviewIndex::remove(mob->netviewId, mob);
+            mob->releaseId();
+            Mob::mobs.removeOne(mob);
+            mob->zone()->mobs.removeOne(mob);
+            delete mob;
+        }
+        Scene::scenes.removeAt(i);
+        removed = true;
+    }
+    if (!removed)
+        return;
+
+    // Nothing holds a SceneId while the server is stopped, the originals can be renumbered
+    Scene::ids.clear();
     for (int i=0; i<Scene::scenes.size(); i++)
-        if (Scene::scenes[i].name .toLower()== sceneName.toLower())
-            scene = Scene::scenes[i];
+    {
+        Scene& scene = Scene::scenes[i];
+        scene.id = scene.baseId = i;
+        scene.instances.clear();
+        scene.instances << scene.id;
+        Scene::ids.insert(scene.name, scene.id);
+    }
+}
 
-    for (int i=0; i<scene.vortexes.size(); i++)
-        if (scene.vortexes[i].id == id)
-            return scene.vortexes[i];
+SceneId findSceneId(const QString& sceneName)
+{
+    return Scene::ids.value(sceneName.toLower(), INVALID_SCENE_ID);
+}
 
-    return Vortex();
+Scene* findScene(SceneId id)
+{
+    if (id >= Scene::scenes.size())
+        return nullptr;
+    return &Scene::scenes[id];
 }
 
-Vortex findVortex(Scene* scene, quint8 id)
+Scene* findScene(const QString& sceneName)
 {
-    for (int i=0; i<scene->vortexes.size(); i++)
-        if (scene->vortexes[i].id == id)
-            return scene->vortexes[i];
+    return findScene(findSceneId(sceneName));
+}
+
+static const Vortex noVortex;
+
+const Vortex& findVortex(SceneId sceneId, quint8 id)
+{
+    Scene* scene = findScene(sceneId);
+    if (!scene)
+        return noVortex;
+    return findVortex(scene, id);
+}
 
-    return Vortex();
+const Vortex& findVortex(const Scene* scene, quint8 id)
+{
+    int index = scene->vortexIndex[id];
+    if (index < 0)
+        return noVortex;
+    return scene->vortexes[index];
 }
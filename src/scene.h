@@ -3,9 +3,21 @@
 
 #include <QString>
 #include <QList>
+#include <QVector>
+#include <QHash>
+#include <QPair>
 #include "dataType.h"
+#include "spatialGrid.h"
+#include "entityStore.h"
+#include "messageBatch.h"
+
+typedef quint16 SceneId; // Index of a scene in Scene::scenes
+#define INVALID_SCENE_ID 0xFFFF
 
 class Player;
+class Pony;
+class Mob;
+struct StatsComponent;
 
 class Vortex
 {
@@ -15,6 +27,7 @@ public:
 public:
     quint8 id;
     QString destName;
+    SceneId destId; // Set by linkVortexes once all the scenes are loaded
     UVector destPos;
     UQuaternion destRot;
 };
@@ -23,18 +36,59 @@ class Scene
 {
 public:
     Scene(QString sceneName);
+    void addPlayer(Player* player); ///< Also puts the player in the grid
+    void removePlayer(Player* player);
+    void addNpc(Pony* npc);
+    void addMob(Mob* mob);
+    void clearNpcs(); ///< Forgets the NPCs, when they're reloaded
+    void clearEntities(); ///< Forgets the NPCs and mobs, when they're reloaded
+    bool addVortex(const Vortex& vortex); ///< False if the scene already has a vortex with this id
 
 public:
-    QString name;
+    QString name; // Always lowercase, shared by all the instances of a scene
+    SceneId id;
+    SceneId baseId; // Scene from the vortex DB this is an instance of, its own id for the original
+    int instance; // 0 for the original scene, then 1, 2, ... for the instances opened when it's full
+    QVector<SceneId> instances; // Of an original scene: ids of all its instances, itself first
+    int maxPlayers; // Players before we open another instance, 0 to use the server's setting, negative for no cap
     QList<Vortex> vortexes;
+    qint16 vortexIndex[256]; // Index in vortexes of each vortex id, -1 if there's no such vortex
     QList<Player*> players; // Used by the 01 sync function
+    QList<Pony*> npcs; // NPCs of the scene, from the quests DB
+    QList<Mob*> mobs; // Mobs of the scene, from the mobzones
+    bool quantizedSync; // Send positions as ranged singles in the sync, only if the clients accept it on this scene
+    UVector boundsMin, boundsMax; // Bounds of the ranged singles, positions outside are clamped
+    SpatialGrid grid; // Players of the scene by position, used by the sync to find who's near who
+    EntityStore entities; // Transform, health and flags of every player, NPC and mob of the scene, packed for the tick systems
+    float syncNearRadius, syncMidRadius; // Sync level of detail for this scene, negative to use the server's settings
+    int syncMidInterval, syncFarInterval; // Sync level of detail for this scene, 0 to use the server's settings
+    QVector<Player*> movedPlayers; // Players that sent a new position since the last movement validation
+    quint64 nSpeedViolations, nHeightViolations, nBoundsViolations; // Positions rejected or clamped by the movement validation
+    quint32 entitiesVersion; // Changes every time an entity joins or leaves the scene
+    MessageBatch entityList; // Instantiates of every entity of the scene, shared by the players loading it. See sendEntitiesList
+    quint32 entityListVersion; // entitiesVersion when entityList was built
+    float entityListTime; // timestampNow() when entityList was built, the positions it has are only good for a tick
+    QVector<QPair<StatsComponent*, float>> dueDamage; // Damage over time due this tick, applied by the scene's SceneSimulationJob
+    int nextMobAI; // Index in mobs of the mob the AI continues with on the next tick
 
 public:
     static QList<Scene> scenes; // List of scenes from the vortex DB
+    static QHash<QString, SceneId> ids; // Id of each original scene by lowercase name, for the few places that parse a scene name
+
+public:
+    QString displayName() const; ///< Name, with the instance number if it's not the original
+    bool isFull() const; ///< True if a new player should go to another instance
 };
-Scene* findScene(QString sceneName);
-Vortex findVortex(QString sceneName, quint8 id);
-Vortex findVortex(Scene* scene, quint8 id);
+SceneId findSceneId(const QString& sceneName); ///< INVALID_SCENE_ID if there's no such scene
+Scene* findScene(SceneId id); ///< nullptr if there's no such scene
+Scene* findScene(const QString& sceneName); ///< nullptr if there's no such scene
+const Vortex& findVortex(SceneId sceneId, quint8 id); ///< A vortex with an INVALID_SCENE_ID destId if there's no such vortex
+const Vortex& findVortex(const Scene* scene, quint8 id); ///< A vortex with an INVALID_SCENE_ID destId if there's no such vortex
 bool ReadVortxXml(QString file);
+void linkVortexes(); ///< Resolves the destination of the vortexes, once all the scenes are loaded
+Scene* pickSceneInstance(SceneId sceneId, Player* player); ///< Instance of the scene the player should join: the one he's in, else the least loaded. nullptr if there's no such scene
+void copyInstanceNpcs(const Scene& base, Scene& instance); ///< Gives the instance its own copies of the NPCs of its original scene
+Scene* createSceneInstance(SceneId baseId); ///< Opens a new instance of the scene, with its own copies of the NPCs and mobs
+void removeSceneInstances(); ///< Closes all the instances, once the game server is stopped
 
 #endif // SCENE_H
@@ -1,57 +1,66 @@
 #include "sceneEntity.h"
-#include "quest.h"
-#include "mob.h"
-#include "player.h"
+#include "scene.h"
 
-int SceneEntity::lastNetviewId;
-int SceneEntity::lastId;
-QMutex SceneEntity::lastIdMutex; // Protects lastId and lastNetviewId
-bool SceneEntity::usedids[65536];
+IdAllocator SceneEntity::idAllocator;
+quint32 SceneEntity::lastSyncVersion;
 
-int SceneEntity::getNewNetviewId()
+QString SceneEntity::sceneName() const
 {
-    int i;
-
-    for (i = 0; i < 65536; i++) {
-        usedids[i] = false;
-    }
-
-    for (int c = 0; c < Quest::npcs.size(); c++) {
-        usedids[Quest::npcs[c]->netviewId] = true;
-    }
-    for (int c = 0; c < Mob::mobs.size(); c++) {
-        usedids[Mob::mobs[c]->netviewId] = true;
-    }
-    for (int c = 0; c < Player::udpPlayers.size(); c++) {
-        usedids[Player::udpPlayers[c]->pony.netviewId] = true;
-    }
-
-    i = 0;
-    while (usedids[i]) i++;
+    Scene* scene = findScene(sceneId);
+    return scene ? scene->name : QString();
+}
 
-    return i;
+void SceneEntity::markSyncDirty()
+{
+    syncVersion = ++lastSyncVersion;
+    if (scene)
+        scene->entities.setTransform(storeHandle, pos, rot);
 }
 
-int SceneEntity::getNewId()
+void SceneEntity::storeHealth(float health)
 {
-    int i;
+    if (scene)
+        scene->entities.setHealth(storeHandle, health);
+}
 
-    for (i = 0; i < 65536; i++) {
-        usedids[i] = false;
+void SceneEntity::rewind(float time, UVector& pos, UQuaternion& rot) const
+{
+    if (!history.at(time, pos, rot))
+    {
+        pos = this->pos;
+        rot = this->rot;
     }
+}
 
-    for (int c = 0; c < Quest::npcs.size(); c++) {
-        usedids[Quest::npcs[c]->id] = true;
-    }
-    for (int c = 0; c < Mob::mobs.size(); c++) {
-        usedids[Mob::mobs[c]->id] = true;
-    }
-    for (int c = 0; c < Player::udpPlayers.size(); c++) {
-        usedids[Player::udpPlayers[c]->pony.id] = true;
-    }
+bool SceneEntity::allocateId()
+{
+    int newId = idAllocator.allocate();
+    if (newId < 0)
+        return false;
+    id = netviewId = newId;
+    idGeneration = idAllocator.generation(netviewId);
+    return true;
+}
 
-    i = 0;
-    while (usedids[i]) i++;
+bool SceneEntity::reserveNetviewId(quint16 NetviewId)
+{
+    if (!idAllocator.reserve(NetviewId))
+        return false;
+    netviewId = NetviewId;
+    idGeneration = idAllocator.generation(netviewId);
+    return true;
+}
 
-    return i;
+void SceneEntity::releaseId()
+{
+    if (hasCurrentId())
+        idAllocator.release(netviewId);
+}
+
+bool SceneEntity::hasCurrentId() const
+{
+    // 0 is reserved for the NPCs and is the netviewId of an entity that never got one (a player before its connect ACK)
+    if (!netviewId)
+        return false;
+    return idAllocator.isCurrent(netviewId, idGeneration);
 }
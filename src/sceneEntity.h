@@ -4,6 +4,9 @@
 #include <QString>
 #include <QMutex>
 #include "dataType.h"
+#include "transformHistory.h"
+#include "idAllocator.h"
+#include "scene.h"
 
 struct SceneEntity
 {
@@ -15,21 +18,30 @@ public:
     QString modelName;
     quint16 id;
     quint16 netviewId;
+    quint16 idGeneration; // Generation of netviewId when the entity got it
 
     // Pos
-    QString sceneName;
+    SceneId sceneId; // Where the entity is, saved with the ponies
+    Scene* scene; // Scene that lists the entity, nullptr while it's not spawned
+    EntityHandle storeHandle; // Entry of the entity in its scene's EntityStore
     UVector pos;
     UQuaternion rot;
+    quint32 syncVersion; // Changes every time pos or rot changes, lets the sync skip entities that didn't move
+    TransformHistory history; // Recent transforms from the sync, to see the entity where a lagging client saw it
 
 public:
-    static int getNewNetviewId();
-    static int getNewId();
+    QString sceneName() const; ///< Name of the entity's scene, or an empty string
+    void markSyncDirty(); ///< Call after changing pos or rot. Gives the entity a new syncVersion and updates the scene's EntityStore
+    void storeHealth(float health); ///< Call after changing the health, copies it to the scene's EntityStore
+    void rewind(float time, UVector& pos, UQuaternion& rot) const; ///< Transform at this time, or the current one if there's no history
+    bool allocateId(); ///< Gives the entity a new id, also used as its netviewId. False if there's no free id left
+    bool reserveNetviewId(quint16 NetviewId); ///< Gives the entity this fixed netviewId (the NPCs use their questId). False if it's used
+    void releaseId(); ///< Returns the netviewId to the allocator, when the entity is destroyed
+    bool hasCurrentId() const; ///< False if the netviewId was released since the entity got it, or if it never got one
 
 public:
-    static int lastNetviewId;
-    static int lastId;
-    static QMutex lastIdMutex; // Protects lastId and lastNetviewId
-    static bool usedids[];
+    static IdAllocator idAllocator; // Only used from the main thread
+    static quint32 lastSyncVersion; // Versions are unique across entities, so a reused netviewId is never mistaken as up to date
 };
 
 #endif // SCENEENTITY_H
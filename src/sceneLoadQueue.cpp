@@ -0,0 +1,200 @@
+#include "sceneLoadQueue.h"
+#include "player.h"
+#include "message.h"
+#include "settings.h"
+#include "utils.h"
+#include "log.h"
+#include "netviewIndex.h"
+
+QList<SceneLoadRequest> SceneLoadQueue::queue;
+QVector<ActiveSceneLoad> SceneLoadQueue::active;
+float SceneLoadQueue::bandwidthTokens = 0;
+float SceneLoadQueue::lastUpdate = 0;
+
+bool SceneLoadQueue::load(Player* player, const QString& sceneName)
+{
+    SceneId sceneId = findSceneId(sceneName);
+    if (sceneId == INVALID_SCENE_ID)
+    {
+        logError(QObject::tr("UDP: Scene %1 not in vortex DB. Aborting scene load.").arg(sceneName));
+        return false;
+    }
+    return load(player, sceneId);
+}
+
+bool SceneLoadQueue::load(Player* player, SceneId sceneId)
+{
+    if (!findScene(sceneId))
+    {
+        logError(QObject::tr("UDP: Can't find scene %1 to load %2, aborting").arg(sceneId).arg(player->name));
+        return false;
+    }
+    SceneLoadRequest request;
+    request.sceneId = sceneId;
+    request.exactInstance = false;
+    request.defaultSpawn = true;
+    request.player = player;
+    enqueue(request);
+    return true;
+}
+
+bool SceneLoadQueue::load(Player* player, SceneId sceneId, UVector pos, UQuaternion rot)
+{
+    if (!findScene(sceneId))
+    {
+        logError(QObject::tr("UDP: Can't find scene %1 to load %2, aborting").arg(sceneId).arg(player->name));
+        return false;
+    }
+    SceneLoadRequest request;
+    request.sceneId = sceneId;
+    request.exactInstance = false;
+    request.defaultSpawn = false;
+    request.pos = pos;
+    request.rot = rot;
+    request.player = player;
+    enqueue(request);
+    return true;
+}
+
+bool SceneLoadQueue::load(Player* player, Scene* instance, UVector pos, UQuaternion rot)
+{
+    if (!instance)
+        return false;
+    SceneLoadRequest request;
+    request.sceneId = instance->id;
+    request.exactInstance = true;
+    request.defaultSpawn = false;
+    request.pos = pos;
+    request.rot = rot;
+    request.player = player;
+    enqueue(request);
+    return true;
+}
+
+void SceneLoadQueue::enqueue(SceneLoadRequest& request)
+{
+    Player* player = request.player;
+    request.netviewId = player->pony.netviewId;
+    request.idGeneration = player->pony.idGeneration;
+    request.queuedTime = timestampNow();
+    request.lastNotice = 0;
+
+    // Already waiting, go somewhere else but keep our place in the queue
+    for (SceneLoadRequest& queued : queue)
+    {
+        if (queued.player == player && isConnected(player, queued.netviewId, queued.idGeneration))
+        {
+            request.queuedTime = queued.queuedTime;
+            request.lastNotice = queued.lastNotice;
+            queued = request;
+            return;
+        }
+    }
+    queue << request;
+}
+
+bool SceneLoadQueue::isConnected(Player* player, quint16 netviewId, quint16 idGeneration)
+{
+    return NetviewIndex::findPlayer(netviewId) == player
+            && SceneEntity::idAllocator.isCurrent(netviewId, idGeneration);
+}
+
+void SceneLoadQueue::update()
+{
+    float now = timestampNow();
+    float dt = lastUpdate ? now - lastUpdate : 0;
+    lastUpdate = now;
+
+    // Refill the bandwidth budget, with at most one second of burst
+    float rate = Settings::loadBandwidth * 1024.0f;
+    if (rate > 0)
+        bandwidthTokens = qMin(rate, bandwidthTokens + rate * dt);
+
+    // Count what the loading players were sent, and retire the finished loads
+    for (int i=0; i<active.size();)
+    {
+        ActiveSceneLoad& load = active[i];
+        bool connected = isConnected(load.player, load.netviewId, load.idGeneration);
+        if (connected)
+        {
+            quint64 bytes = load.player->nReliableBytes;
+            bandwidthTokens -= bytes >= load.lastBytes ? bytes - load.lastBytes : bytes; // The counter restarts on reconnection
+            load.lastBytes = bytes;
+        }
+        if (!connected || load.player->inGame >= 3 || now - load.startTime > LOAD_TIMEOUT)
+            active.remove(i);
+        else
+            i++;
+    }
+
+    // Start the longest waiting loads that fit
+    while (!queue.isEmpty())
+    {
+        if (Settings::maxConcurrentLoads > 0 && active.size() >= Settings::maxConcurrentLoads)
+            break;
+        if (rate > 0 && bandwidthTokens <= 0)
+            break;
+        SceneLoadRequest request = queue.takeFirst();
+        if (isConnected(request.player, request.netviewId, request.idGeneration))
+            start(request);
+    }
+
+    // Tell the others where they are
+    for (int i=0; i<queue.size();)
+    {
+        SceneLoadRequest& request = queue[i];
+        if (!isConnected(request.player, request.netviewId, request.idGeneration))
+        {
+            queue.removeAt(i);
+            continue;
+        }
+        if (now - request.lastNotice >= LOAD_QUEUE_NOTICE_INTERVAL)
+        {
+            request.lastNotice = now;
+            Scene* scene = findScene(request.sceneId);
+            sendChatMessage(request.player, QObject::tr("<span color=\"yellow\">Many ponies are travelling, loading %1 in a moment (%2 in the queue)</span>")
+                            .arg(scene ? scene->name : QString()).arg(i+1), "[Server]", ChatSystem, 0);
+        }
+        i++;
+    }
+}
+
+void SceneLoadQueue::start(const SceneLoadRequest& request)
+{
+    Player* player = request.player;
+    bool ok;
+    if (request.exactInstance)
+        ok = sendLoadSceneRPC(player, findScene(request.sceneId), request.pos, request.rot);
+    else if (request.defaultSpawn)
+        ok = sendLoadSceneRPC(player, request.sceneId);
+    else
+        ok = sendLoadSceneRPC(player, request.sceneId, request.pos, request.rot);
+    if (!ok)
+        return;
+
+    ActiveSceneLoad load;
+    load.player = player;
+    load.netviewId = request.netviewId;
+    load.idGeneration = request.idGeneration;
+    load.startTime = timestampNow();
+    load.lastBytes = player->nReliableBytes;
+    active << load;
+}
+
+void SceneLoadQueue::clear()
+{
+    queue.clear();
+    active.clear();
+    bandwidthTokens = 0;
+    lastUpdate = 0;
+}
+
+int SceneLoadQueue::waiting()
+{
+    return queue.size();
+}
+
+int SceneLoadQueue::loading()
+{
+    return active.size();
+}
@@ -0,0 +1,67 @@
+#ifndef SCENELOADQUEUE_H
+#define SCENELOADQUEUE_H
+
+#include <QList>
+#include <QVector>
+#include <QString>
+#include "dataType.h"
+#include "scene.h"
+
+#define LOAD_TIMEOUT 30 // Time in s after which we stop counting a load that didn't finish against the budgets
+#define LOAD_QUEUE_NOTICE_INTERVAL 5 // Time in s between two queue position messages to a waiting player
+
+class Player;
+
+/// A scene change waiting for its turn
+struct SceneLoadRequest
+{
+    Player* player;
+    quint16 netviewId, idGeneration; // To notice if the player disconnected meanwhile
+    SceneId sceneId;
+    bool exactInstance; // Load this instance, don't pick one with pickSceneInstance
+    bool defaultSpawn; // Go to the scene's spawn, ignore pos and rot
+    UVector pos;
+    UQuaternion rot;
+    float queuedTime; // timestampNow() when the player started waiting
+    float lastNotice; // timestampNow() of the last queue position message, 0 if none
+};
+
+/// A scene change that was admitted, until the client finished loading
+struct ActiveSceneLoad
+{
+    Player* player;
+    quint16 netviewId, idGeneration;
+    float startTime;
+    quint64 lastBytes; // player->nReliableBytes already counted against the bandwidth budget
+};
+
+/// Admission control for the scene loads.
+/// When lots of players change scenes at once (event teleports, restarts), loading the scene and sending the entities
+/// for all of them at the same time saturates the reliable channel. The loads wait here instead, the longest waiting first,
+/// and start only while there are less than Settings::maxConcurrentLoads loading
+/// and the reliable messages of the loading players fit in Settings::loadBandwidth.
+class SceneLoadQueue
+{
+public:
+    static bool load(Player* player, const QString& sceneName); ///< Queues a load to the default spawn. False if there's no such scene
+    static bool load(Player* player, SceneId sceneId); ///< Queues a load to the default spawn. False if there's no such scene
+    static bool load(Player* player, SceneId sceneId, UVector pos, UQuaternion rot); ///< Queues a load, the instance is picked when it starts
+    static bool load(Player* player, Scene* instance, UVector pos, UQuaternion rot); ///< Queues a load to this instance
+    static void update(); ///< Starts the loads that fit the budgets, once per tick on the main thread
+    static void clear();
+    static int waiting(); ///< Number of queued loads
+    static int loading(); ///< Number of loads in progress
+
+private:
+    static void enqueue(SceneLoadRequest& request);
+    static bool isConnected(Player* player, quint16 netviewId, quint16 idGeneration);
+    static void start(const SceneLoadRequest& request);
+
+private:
+    static QList<SceneLoadRequest> queue; // Longest waiting first
+    static QVector<ActiveSceneLoad> active;
+    static float bandwidthTokens; // Bytes we can still send to the loading players, refilled at loadBandwidth
+    static float lastUpdate; // timestampNow() of the last update
+};
+
+#endif // SCENELOADQUEUE_H
@@ -0,0 +1,51 @@
+#include "sceneSimulation.h"
+#include "scene.h"
+#include "skill.h"
+#include "mobAI.h"
+#include "message.h"
+#include <QtConcurrent/QtConcurrent>
+
+QVector<SceneSimulationJob> SceneSimulation::jobs;
+thread_local SceneSimulationJob* SceneSimulation::current = nullptr;
+
+void SceneSimulation::run(float now)
+{
+    int nJobs = 0;
+    for (int i=0; i<Scene::scenes.size(); i++)
+    {
+        Scene& scene = Scene::scenes[i];
+        if (scene.players.isEmpty() && scene.dueDamage.isEmpty()) // Nopony would see the mobs, they can wait
+            continue;
+        if (nJobs == jobs.size())
+            jobs.resize(nJobs+1);
+        SceneSimulationJob& job = jobs[nJobs++];
+        job.scene = &scene;
+        job.outbox.clear();
+    }
+    jobs.resize(nJobs);
+
+    // The scenes don't share players or mobs, so they can run in parallel.
+    // The main thread waits here, nothing else touches the scenes meanwhile.
+    if (nJobs > 1)
+        QtConcurrent::blockingMap(jobs, [now](SceneSimulationJob& job){runJob(job, now);});
+    else if (nJobs == 1)
+        runJob(jobs[0], now);
+
+    // Back on the main thread, in the order each scene sent them
+    for (SceneSimulationJob& job : jobs)
+        for (const QueuedMessage& msg : job.outbox)
+            sendMessage(msg.player, msg.messageType, msg.data);
+}
+
+SceneSimulationJob* SceneSimulation::currentJob()
+{
+    return current;
+}
+
+void SceneSimulation::runJob(SceneSimulationJob& job, float now)
+{
+    current = &job;
+    Skill::applyDueDamage(*job.scene); // Before the AI, a mob killed by its poison doesn't get a turn
+    MobAI::updateScene(job, now);
+    current = nullptr;
+}
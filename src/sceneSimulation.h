@@ -0,0 +1,50 @@
+#ifndef SCENESIMULATION_H
+#define SCENESIMULATION_H
+
+#include <QVector>
+#include <QByteArray>
+#include "dataType.h"
+
+class Scene;
+class Player;
+class Mob;
+
+/// A message sent by a scene job, waiting for the main thread
+struct QueuedMessage
+{
+    Player* player;
+    quint8 messageType;
+    QByteArray data;
+};
+
+/// Simulation work of one scene: the damage over time and the mob AI. Ran by a worker thread, sent by the main thread
+struct SceneSimulationJob
+{
+    Scene* scene;
+    QVector<QueuedMessage> outbox; // What the scene's entities sent, in order
+    // The current mob AI batch, kept between ticks to reuse their memory
+    QVector<Mob*> batch; // Mobs of the batch
+    QVector<UVector> points; // Position of each mob of the batch
+    QVector<float> radii; // Aggro range of each mob of the batch, 0 if it isn't looking for a target
+    QVector<Player*> seen; // Nearest pony in range of each mob of the batch
+};
+
+/// Runs the simulation of the scenes in parallel, in the simulation phase of the tick.
+/// A job only touches its scene's players, mobs and entities. The messages they send go to the job's outbox,
+/// since sendMessage writes the player's sequence numbers and timers. The work that changes more than one scene
+/// (scene reloads, respawn scheduling) goes through ServerTick::post.
+class SceneSimulation
+{
+public:
+    static void run(float now); ///< Runs the job of every scene with players, then sends what they queued
+    static SceneSimulationJob* currentJob(); ///< The job running on this thread, nullptr outside of the jobs
+
+private:
+    static void runJob(SceneSimulationJob& job, float now);
+
+private:
+    static QVector<SceneSimulationJob> jobs; // Kept between ticks to reuse the outboxes' memory
+    static thread_local SceneSimulationJob* current;
+};
+
+#endif // SCENESIMULATION_H
@@ -5,10 +5,19 @@
 #include "packetloss.h"
 #include "log.h"
 #include "udp.h"
+#include "messageBatch.h"
+#include "sceneSimulation.h"
 #include <QUdpSocket>
 
 void sendMessage(Player* player,quint8 messageType, QByteArray data)
 {
+    // A scene job on a worker thread can't touch the player's sequence numbers and timers, the main thread sends it after the jobs
+    if (SceneSimulationJob* job = SceneSimulation::currentJob())
+    {
+        job->outbox << QueuedMessage{player, messageType, data};
+        return;
+    }
+
     QByteArray msg(3,0);
     // MessageType
     msg[0] = messageType;
@@ -27,6 +36,8 @@ void sendMessage(Player* player,quint8 messageType, QByteArray data)
         // Ping number
         player->lastPingNumber++;
         msg[5]=(quint8)player->lastPingNumber;
+        player->sentPingNumber = (quint8)player->lastPingNumber;
+        player->sentPingTime = timestampNow();
     }
     else if (messageType == MsgPong)
     {
@@ -41,16 +52,8 @@ void sendMessage(Player* player,quint8 messageType, QByteArray data)
     }
     else if (messageType == MsgUserUnreliable)
     {
-        msg.resize(5);
-        // Sequence
-        msg[1] = (quint8)(player->udpSequenceNumbers[32]&0xFF);
-        msg[2] = (quint8)((player->udpSequenceNumbers[32]>>8)&0xFF);
-        // Data size
-        msg[3] = (quint8)((8*(data.size()))&0xFF);
-        msg[4] = (quint8)(((8*(data.size())) >> 8)&0xFF);
-        // Data
-        msg += data;
-        player->udpSequenceNumbers[32]++;
+        msg.clear();
+        appendUnreliableMessage(player, msg, data);
 
         //logMessage(QString("Sending sync data :")+msg.toHex());
     }
@@ -69,6 +72,7 @@ void sendMessage(Player* player,quint8 messageType, QByteArray data)
         // strlen
         msg+=data;
         player->udpSequenceNumbers[messageType-MsgUserReliableOrdered1] += 2;
+        player->nReliableBytes += msg.size();
 
         if (player->udpSendReliableGroupBuffer.size() + msg.size() > 1024) // Flush the buffer before starting a new grouped msg
             player->udpDelayedSend();
@@ -131,6 +135,68 @@ void sendMessage(Player* player,quint8 messageType, QByteArray data)
         return;
     }
 
+    sendDatagram(player, msg);
+}
+
+void sendMessageBatch(Player* player, const MessageBatch& batch)
+{
+    if (SceneSimulationJob* job = SceneSimulation::currentJob())
+    {
+        for (int i=0; i<batch.count(); i++) // Without the header, sendMessage writes it again
+            job->outbox << QueuedMessage{player, (quint8)batch.buffer[batch.offsets[i]],
+                                         batch.buffer.mid(batch.offsets[i]+5, batch.messageSize(i)-5)};
+        return;
+    }
+
+    player->udpSendReliableMutex.lock();
+    player->udpSendReliableGroupTimer->stop();
+    QByteArray& group = player->udpSendReliableGroupBuffer;
+    for (int i=0; i<batch.count(); i++)
+    {
+        int start = batch.offsets[i];
+        int size = batch.messageSize(i);
+        if (!group.isEmpty() && group.size() + size > UDP_BATCH_MTU) // This one doesn't fit, send the full grouped msg
+            player->udpFlushGroupBuffer();
+
+        // Same message, with the player's sequence number
+        int pos = group.size();
+        group.append(batch.buffer.constData()+start, size);
+        quint16& sequence = player->udpSequenceNumbers[(quint8)batch.buffer[start]-MsgUserReliableOrdered1];
+        group[pos+1] = (quint8)(sequence&0xFF);
+        group[pos+2] = (quint8)((sequence >> 8)&0xFF);
+        sequence += 2;
+        player->nReliableBytes += size;
+    }
+    player->udpSendReliableGroupTimer->start(); // The last grouped msg may still have room for the next messages
+    player->udpSendReliableMutex.unlock();
+}
+
+void appendUnreliableMessage(Player* player, QByteArray& datagram, const QByteArray& data)
+{
+    int start = datagram.size();
+    datagram.resize(start+5);
+    // MessageType
+    datagram[start] = MsgUserUnreliable;
+    // Sequence
+    datagram[start+1] = (quint8)(player->udpSequenceNumbers[32]&0xFF);
+    datagram[start+2] = (quint8)((player->udpSequenceNumbers[32]>>8)&0xFF);
+    // Data size
+    datagram[start+3] = (quint8)((8*(data.size()))&0xFF);
+    datagram[start+4] = (quint8)(((8*(data.size())) >> 8)&0xFF);
+    // Data
+    datagram += data;
+    player->udpSequenceNumbers[32]++;
+}
+
+void sendDatagram(Player* player, const QByteArray& msg)
+{
+#ifdef UDP_NULL_SOCKET
+    Q_UNUSED(player);
+    udpNullDatagrams++;
+    udpNullBytes += msg.size();
+    return;
+#endif
+
     // Simulate packet loss if enabled (DEBUG ONLY!)
 #if UDP_SIMULATE_PACKETLOSS
     if (qrand() % 100 <= UDP_SEND_PERCENT_DROPPED)
@@ -7,5 +7,7 @@
 #define UDP_RESEND_TIMEOUT 500
 // If we send multiple reliable messages before this timeouts, group them before sending. Increases the latency.
 #define UDP_GROUPING_TIMEOUT 25
+// Max size of a grouped message sent by sendMessageBatch, the default MTU of the client's Lidgren
+#define UDP_BATCH_MTU 1408
 
 #endif // SENDMESSAGE_H
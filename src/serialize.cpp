@@ -153,7 +153,11 @@ QByteArray rangedSingleToData(float value, float min, float max, int numberOfBit
     QByteArray data;
     float num = max - min;
     float num2 = (value - min) / num;
-    int num3 = (((int) 1) << numberOfBits) - 1;
+    if (num2 < 0) // Out of bounds values would wrap around
+        num2 = 0;
+    else if (num2 > 1)
+        num2 = 1;
+    uint num3 = (((quint64) 1) << numberOfBits) - 1;
     uint source = num3 * num2;
 
     if (numberOfBits <= 8)
@@ -165,18 +169,18 @@ QByteArray rangedSingleToData(float value, float min, float max, int numberOfBit
     numberOfBits -= 8;
     if (numberOfBits <= 8)
     {
-        data += (unsigned char)source>>8;
+        data += (unsigned char)(source>>8);
         return data;
     }
-    data += (unsigned char)source>>8;
+    data += (unsigned char)(source>>8);
     numberOfBits -= 8;
     if (numberOfBits <= 8)
     {
-        data += (unsigned char)source>>16;
+        data += (unsigned char)(source>>16);
         return data;
     }
-    data += (unsigned char)source>>16;
-    data += (unsigned char)source>>24;
+    data += (unsigned char)(source>>16);
+    data += (unsigned char)(source>>24);
 
     return data;
 }
@@ -0,0 +1,96 @@
+# Sources of the server, without main.cpp.
+# Shared by the server and the tools that link against its code (tools/syncBench)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/tcp.cpp \
+    $$PWD/udp.cpp \
+    $$PWD/messages.cpp \
+    $$PWD/utils.cpp \
+    $$PWD/pingTimeout.cpp \
+    $$PWD/scene.cpp \
+    $$PWD/dataType.cpp \
+    $$PWD/sync.cpp \
+    $$PWD/serverTick.cpp \
+    $$PWD/sceneSimulation.cpp \
+    $$PWD/spatialGrid.cpp \
+    $$PWD/entityStore.cpp \
+    $$PWD/entityStreaming.cpp \
+    $$PWD/sceneLoadQueue.cpp \
+    $$PWD/moveValidation.cpp \
+    $$PWD/receiveMessage.cpp \
+    $$PWD/sendMessage.cpp \
+    $$PWD/messageBatch.cpp \
+    $$PWD/serverCommands.cpp \
+    $$PWD/quest.cpp \
+    $$PWD/serialize.cpp \
+    $$PWD/items.cpp \
+    $$PWD/receiveAck.cpp \
+    $$PWD/receiveChatMessage.cpp \
+    $$PWD/mobsParser.cpp \
+    $$PWD/mobzone.cpp \
+    $$PWD/mob.cpp \
+    $$PWD/mobAI.cpp \
+    $$PWD/mobRespawn.cpp \
+    $$PWD/proximity.cpp \
+    $$PWD/mobStats.cpp \
+    $$PWD/skill.cpp \
+    $$PWD/skillparser.cpp \
+    $$PWD/animationparser.cpp \
+    $$PWD/animation.cpp \
+    $$PWD/log.cpp \
+    $$PWD/player.cpp \
+    $$PWD/playerSerialization.cpp \
+    $$PWD/sceneEntity.cpp \
+    $$PWD/idAllocator.cpp \
+    $$PWD/netviewIndex.cpp \
+    $$PWD/transformHistory.cpp \
+    $$PWD/settings.cpp \
+    $$PWD/app.cpp \
+    $$PWD/appStartStopServer.cpp
+
+HEADERS  += \
+    $$PWD/build.h \
+    $$PWD/message.h \
+    $$PWD/utils.h \
+    $$PWD/scene.h \
+    $$PWD/dataType.h \
+    $$PWD/sync.h \
+    $$PWD/serverTick.h \
+    $$PWD/sceneSimulation.h \
+    $$PWD/spatialGrid.h \
+    $$PWD/entityStore.h \
+    $$PWD/entityStreaming.h \
+    $$PWD/sceneLoadQueue.h \
+    $$PWD/moveValidation.h \
+    $$PWD/quest.h \
+    $$PWD/serialize.h \
+    $$PWD/items.h \
+    $$PWD/sendMessage.h \
+    $$PWD/messageBatch.h \
+    $$PWD/receiveAck.h \
+    $$PWD/receiveChatMessage.h \
+    $$PWD/mobzone.h \
+    $$PWD/sceneEntity.h \
+    $$PWD/idAllocator.h \
+    $$PWD/netviewIndex.h \
+    $$PWD/transformHistory.h \
+    $$PWD/mobsParser.h \
+    $$PWD/mob.h \
+    $$PWD/mobAI.h \
+    $$PWD/mobRespawn.h \
+    $$PWD/proximity.h \
+    $$PWD/mobsStats.h \
+    $$PWD/packetloss.h \
+    $$PWD/skill.h \
+    $$PWD/skillparser.h \
+    $$PWD/statsComponent.h \
+    $$PWD/animationparser.h \
+    $$PWD/animation.h \
+    $$PWD/log.h \
+    $$PWD/player.h \
+    $$PWD/settings.h \
+    $$PWD/udp.h \
+    $$PWD/rpc.h \
+    $$PWD/app.h
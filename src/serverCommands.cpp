@@ -4,8 +4,11 @@
 #include "serialize.h"
 #include "mob.h"
 #include "sync.h"
+#include "serverTick.h"
 #include "settings.h"
 #include "scene.h"
+#include "netviewIndex.h"
+#include "sceneLoadQueue.h"
 #include <Qt>
 #include <QDir>
 
@@ -79,6 +82,12 @@ void App::sendCmdLine()
         logMessage(QObject::tr("%1 List all the vortexrs currently in the game").arg(indent));
         logMessage("sync");
         logMessage(QObject::tr("%1 Syncs the positions of all clients now").arg(indent));
+        logMessage("syncStats");
+        logMessage(QObject::tr("%1 Shows how many sync messages were sent and skipped").arg(indent));
+        logMessage("moveStats");
+        logMessage(QObject::tr("%1 Shows how many positions the movement validation rejected or clamped, by scene").arg(indent));
+        logMessage("tickStats [reset]");
+        logMessage(QObject::tr("%1 Shows how long each phase of the game loop takes, and how many ticks were late").arg(indent));
         logMessage("tele [sourceponyid] [destponyid]");
         logMessage(QObject::tr("%1 Move sourcepony to destpony's location").arg(indent));
         logMessage("dbgStressLoad [scene]");
@@ -425,13 +434,19 @@ void App::sendCmdLine()
         }
         str = str.right(str.size()-10);
         Scene* scene = findScene(str);
-        if (scene->name.isEmpty())
+        if (!scene)
             logMessage(QObject::tr("Can't find scene"));
         else
-            for (int i=0; i<scene->players.size();i++)
-                logMessage(Player::udpPlayers[i]->IP
-                               +":"+QString().setNum(Player::udpPlayers[i]->port)
-                               +" "+QString().setNum((int)timestampNow()-Player::udpPlayers[i]->lastPingTime)+"s");
+        {
+            for (SceneId id : scene->instances)
+            {
+                Scene& instance = Scene::scenes[id];
+                for (int i=0; i<instance.players.size();i++)
+                    logMessage(instance.displayName()+"   "+instance.players[i]->IP
+                                   +":"+QString().setNum(instance.players[i]->port)
+                                   +" "+QString().setNum((int)timestampNow()-instance.players[i]->lastPingTime)+"s");
+            }
+        }
         return;
     }
     else if (str.startsWith("listVortexes", Qt::CaseInsensitive))
@@ -448,6 +463,37 @@ void App::sendCmdLine()
         }
         return;
     }
+    else if (str.startsWith("tickStats", Qt::CaseInsensitive))
+    {
+        tick->printStats();
+        if (str.endsWith("reset", Qt::CaseInsensitive))
+            tick->resetStats();
+        return;
+    }
+    else if (str.startsWith("syncStats", Qt::CaseInsensitive))
+    {
+        quint64 total = sync->nSent + sync->nSuppressed + sync->nDeferred;
+        logMessage(QObject::tr("Sync: %1 sent, %2 skipped, %3 deferred to a later tick (%4% not sent)")
+                   .arg(sync->nSent).arg(sync->nSuppressed).arg(sync->nDeferred)
+                   .arg(total ? 100*(sync->nSuppressed+sync->nDeferred)/total : 0));
+        return;
+    }
+    else if (str.startsWith("moveStats", Qt::CaseInsensitive))
+    {
+        bool found = false;
+        for (int i=0; i<Scene::scenes.size(); i++)
+        {
+            const Scene& scene = Scene::scenes[i];
+            if (!scene.nSpeedViolations && !scene.nHeightViolations && !scene.nBoundsViolations)
+                continue;
+            found = true;
+            logMessage(QObject::tr("Moves: %1: %2 too fast, %3 too high or low, %4 out of bounds")
+                       .arg(scene.name).arg(scene.nSpeedViolations).arg(scene.nHeightViolations).arg(scene.nBoundsViolations));
+        }
+        if (!found)
+            logMessage(QObject::tr("Moves: no violations"));
+        return;
+    }
     else if (str.startsWith("sync", Qt::CaseInsensitive))
     {
         logMessage(QObject::tr("UDP: Syncing manually"));
@@ -457,17 +503,17 @@ void App::sendCmdLine()
     // DEBUG global commands from now on
     else if (str==("dbgStressLoad"))
     {
-        // Send all the players to the GemMines at the same time
+        // Send all the players to the GemMines at the same time, through the load queue
         for (int i=0; i<Player::udpPlayers.size(); i++)
-            sendLoadSceneRPC(Player::udpPlayers[i], "GemMines");
+            SceneLoadQueue::load(Player::udpPlayers[i], "GemMines");
         return;
     }
     else if (str.startsWith("dbgStressLoad", Qt::CaseInsensitive))
     {
         str = str.mid(14);
-        // Send all the players to the given scene at the same time
+        // Send all the players to the given scene at the same time, through the load queue
         for (int i=0; i<Player::udpPlayers.size(); i++)
-            sendLoadSceneRPC(Player::udpPlayers[i], str);
+            SceneLoadQueue::load(Player::udpPlayers[i], str);
         return;
     }
     else if (str.startsWith("tele", Qt::CaseInsensitive))
@@ -509,8 +555,8 @@ void App::sendCmdLine()
             if (Player::udpPlayers[i]->pony.id == destID)
             {
                 logMessage(QObject::tr("UDP: Teleported %1 to %2").arg(sourcePeer->pony.name,Player::udpPlayers[i]->pony.name));
-                if (Player::udpPlayers[i]->pony.sceneName.toLower() != sourcePeer->pony.sceneName.toLower())
-                    sendLoadSceneRPC(sourcePeer, Player::udpPlayers[i]->pony.sceneName, Player::udpPlayers[i]->pony.pos, Player::udpPlayers[i]->pony.rot);
+                if (Player::udpPlayers[i]->pony.sceneId != sourcePeer->pony.sceneId && Player::udpPlayers[i]->pony.scene)
+                    SceneLoadQueue::load(sourcePeer, Player::udpPlayers[i]->pony.scene, Player::udpPlayers[i]->pony.pos, Player::udpPlayers[i]->pony.rot);
                 else
                     sendMove(sourcePeer, Player::udpPlayers[i]->pony.pos.x, Player::udpPlayers[i]->pony.pos.y, Player::udpPlayers[i]->pony.pos.z);
                 return;
@@ -543,7 +589,7 @@ void App::sendCmdLine()
     else if (str.startsWith("load", Qt::CaseInsensitive))
     {
         str = str.mid(5);
-        sendLoadSceneRPC(cmdPeer, str);
+        SceneLoadQueue::load(cmdPeer, str);
     }
     else if (str.startsWith("getPos", Qt::CaseInsensitive))
     {
@@ -601,21 +647,58 @@ void App::sendCmdLine()
         if (npc != NULL)
         {
             // Reload the NPCs from the DB
+            for (Pony* oldNpc : Quest::npcs)
+            {
+                NetviewIndex::remove(oldNpc->netviewId, oldNpc);
+                oldNpc->releaseId();
+            }
             Quest::npcs.clear();
             Quest::quests.clear();
+            for (int i=0; i<Scene::scenes.size(); i++)
+            {
+                Scene& scene = Scene::scenes[i];
+                QList<Pony*> copies = scene.npcs;
+                scene.clearNpcs();
+                if (scene.id != scene.baseId) // The instances own their copies
+                    for (Pony* copy : copies)
+                        delete copy;
+            }
             unsigned nQuests = 0;
             QDir npcsDir("data/npcs/");
             QStringList files = npcsDir.entryList(QDir::Files);
             for (int i=0; i<files.size(); i++, nQuests++) // For each vortex file
             {
                 Quest *quest = new Quest("data/npcs/"+files[i], NULL);
+                if (!quest->npc->reserveNetviewId(quest->npc->netviewId))
+                    logError(tr("Error, two quests are using the same id (%1) !").arg(quest->id));
                 Quest::quests << *quest;
                 Quest::npcs << quest->npc;
+                if (Scene* scene = findScene(quest->npc->sceneId))
+                    scene->addNpc(quest->npc);
+                NetviewIndex::addNpc(quest->npc->netviewId, quest->npc);
             }
             logMessage(tr("Loaded %1 quests/npcs").arg(nQuests));
 
-            // Resend the NPC if needed
-            if (npc->sceneName.toLower() == cmdPeer->pony.sceneName.toLower())
+            // The open instances get copies of the new NPCs
+            for (int i=0; i<Scene::scenes.size(); i++)
+            {
+                Scene& scene = Scene::scenes[i];
+                if (scene.id != scene.baseId)
+                    copyInstanceNpcs(Scene::scenes[scene.baseId], scene);
+            }
+
+            // Resend the NPC if needed. npc is the old one, the instances have copies of the original scene's
+            npc = nullptr;
+            for (Pony* newNpc : Quest::npcs)
+            {
+                if (newNpc->name == str)
+                {
+                    npc = newNpc;
+                    break;
+                }
+            }
+            Scene* peerScene = findScene(cmdPeer->pony.sceneId);
+            if (npc && peerScene && npc->sceneId == peerScene->baseId)
             {
                 sendNetviewRemove(cmdPeer, npc->netviewId);
                 sendNetviewInstantiate(npc, cmdPeer);
@@ -865,7 +948,8 @@ void App::sendCmdLine()
                            +"/"+QString().setNum(mob->netviewId)
                            +" "+mob->modelName+" at "+QString().setNum(mob->pos.x)
                            +" "+QString().setNum(mob->pos.y)
-                           +" "+QString().setNum(mob->pos.z));
+                           +" "+QString().setNum(mob->pos.z)
+                           +(mob->dead ? tr(" (dead)") : QString()));
         }
     }
     else if (str==("listInventory"))
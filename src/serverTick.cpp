@@ -0,0 +1,205 @@
+#include "serverTick.h"
+#include "sync.h"
+#include "skill.h"
+#include "moveValidation.h"
+#include "player.h"
+#include "udp.h"
+#include "utils.h"
+#include "app.h"
+#include "log.h"
+#include "settings.h"
+#include "netviewIndex.h"
+#include "entityStreaming.h"
+#include "sceneLoadQueue.h"
+#include "sceneSimulation.h"
+#include "mobRespawn.h"
+#include <climits>
+
+const char* ServerTick::phaseNames[PhaseCount] = {"input", "simulation", "sync", "output"};
+const int ServerTick::bucketLimits[TICK_HISTOGRAM_BUCKETS] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, INT_MAX};
+QVector<std::function<void()>> ServerTick::posted;
+QMutex ServerTick::postedMutex;
+
+ServerTick::ServerTick(Sync* Sync, QObject* parent)
+    : QObject(parent), sync{Sync}, nextTick{0}, nextSync{0}, nextPingCheck{0},
+      interval{DEFAULT_TICK_INTERVAL}, syncInterval{DEFAULT_SYNC_INTERVAL}, pingCheckInterval{DEFAULT_PING_CHECK}
+{
+    tickTimer = new QTimer(this);
+    tickTimer->setSingleShot(true);
+    tickTimer->setTimerType(Qt::PreciseTimer);
+    connect(tickTimer, SIGNAL(timeout()), this, SLOT(run()));
+    resetStats();
+}
+
+void ServerTick::start(int tickInterval, int SyncInterval, int PingCheckInterval)
+{
+    interval = qMax(1, tickInterval);
+    syncInterval = SyncInterval;
+    pingCheckInterval = PingCheckInterval;
+    clock.start();
+    nextTick = interval;
+    nextSync = syncInterval;
+    nextPingCheck = pingCheckInterval;
+    tickTimer->start(interval);
+}
+
+void ServerTick::stop()
+{
+    tickTimer->stop();
+
+    // The posted tasks can point to the mobs and instances the stop deletes
+    QMutexLocker lock(&postedMutex);
+    posted.clear();
+}
+
+void ServerTick::run()
+{
+    // Run the late ticks back to back, but not too many or we'd never catch up
+    int nRan = 0;
+    while (clock.elapsed() >= nextTick && nRan < TICK_MAX_CATCHUP)
+    {
+        QElapsedTimer tickTime;
+        tickTime.start();
+        runTick();
+        if (tickTime.elapsed() > interval)
+            nOverruns++;
+        nextTick += interval;
+        nRan++;
+    }
+
+    // Still late, drop the ticks we missed and start again from now
+    qint64 now = clock.elapsed();
+    if (now >= nextTick)
+    {
+        qint64 late = (now - nextTick) / interval + 1;
+        nSkipped += late;
+        nextTick += late * interval;
+    }
+
+    tickTimer->start(qMax<qint64>(0, nextTick - clock.elapsed()));
+}
+
+void ServerTick::runTick()
+{
+    QElapsedTimer phaseTime;
+    nTicks++;
+
+    // Input: everything the clients sent since the last tick
+    phaseTime.start();
+    udpProcessPendingDatagrams();
+    record(Input, phaseTime.nsecsElapsed());
+
+    // Simulation
+    phaseTime.start();
+    MoveValidation::validate(timestampNow()); // Before anything uses the positions we just received
+    runPosted();
+    SceneLoadQueue::update(); // After the posted tasks, they queue loads
+    Skill::collectEffects(timestampNow());
+    MobRespawn::update(timestampNow()); // Before the scene jobs, the mobs it revives get their AI turn
+    SceneSimulation::run(timestampNow()); // The damage over time and the mob AI, one job per scene
+    if (clock.elapsed() >= nextPingCheck)
+    {
+        nextPingCheck = clock.elapsed() + pingCheckInterval;
+        app.checkPingTimeouts();
+    }
+    record(Simulation, phaseTime.nsecsElapsed());
+
+    // Sync, every syncInterval
+    phaseTime.start();
+    if (clock.elapsed() >= nextSync)
+    {
+        nextSync = clock.elapsed() + syncInterval;
+        EntityStreaming::update(); // First, the sync only sends the entities the clients know
+        if (Settings::enableMultiplayer)
+            sync->doSync();
+    }
+    record(SyncBuild, phaseTime.nsecsElapsed());
+
+    // Output: send what each phase grouped for the players now, instead of waiting for their grouping timer
+    phaseTime.start();
+    for (int i=0; i<Player::udpPlayers.size(); i++)
+    {
+        Player* player = Player::udpPlayers[i];
+        if (player->udpSendReliableGroupBuffer.isEmpty())
+            continue;
+        player->udpSendReliableGroupTimer->stop();
+        player->udpDelayedSend();
+    }
+    record(Output, phaseTime.nsecsElapsed());
+}
+
+void ServerTick::post(std::function<void()> task)
+{
+    QMutexLocker lock(&postedMutex);
+    posted << task;
+}
+
+void ServerTick::post(Player* player, std::function<void()> task)
+{
+    // A new player can get the same address after a disconnect, but not the same id generation
+    quint16 netviewId = player->pony.netviewId;
+    quint16 generation = player->pony.idGeneration;
+    post([player, netviewId, generation, task]()
+    {
+        if (NetviewIndex::findPlayer(netviewId) == player
+                && SceneEntity::idAllocator.isCurrent(netviewId, generation))
+            task();
+    });
+}
+
+void ServerTick::runPosted()
+{
+    QVector<std::function<void()>> tasks;
+    postedMutex.lock();
+    tasks.swap(posted);
+    postedMutex.unlock();
+
+    // The tasks can post more tasks, those wait for the next tick
+    for (const std::function<void()>& task : tasks)
+        task();
+}
+
+void ServerTick::record(Phase phase, qint64 nsecs)
+{
+    qint64 usecs = nsecs / 1000;
+    int bucket = 0;
+    while (usecs >= bucketLimits[bucket] && bucket < TICK_HISTOGRAM_BUCKETS-1)
+        bucket++;
+    histogram[phase][bucket]++;
+    totalTime[phase] += nsecs;
+    if (nsecs > maxTime[phase])
+        maxTime[phase] = nsecs;
+}
+
+void ServerTick::resetStats()
+{
+    nTicks = nOverruns = nSkipped = 0;
+    for (int i=0; i<PhaseCount; i++)
+    {
+        maxTime[i] = totalTime[i] = 0;
+        for (int j=0; j<TICK_HISTOGRAM_BUCKETS; j++)
+            histogram[i][j] = 0;
+    }
+}
+
+void ServerTick::printStats()
+{
+    logMessage(tr("Tick: %1 ticks of %2ms, %3 overruns, %4 skipped")
+               .arg(nTicks).arg(interval).arg(nOverruns).arg(nSkipped));
+    if (!nTicks)
+        return;
+
+    for (int i=0; i<PhaseCount; i++)
+    {
+        QString buckets;
+        for (int j=0; j<TICK_HISTOGRAM_BUCKETS; j++)
+        {
+            if (j == TICK_HISTOGRAM_BUCKETS-1)
+                buckets += QString(" >=%1us:%2").arg(bucketLimits[j-1]).arg(histogram[i][j]);
+            else
+                buckets += QString(" <%1us:%2").arg(bucketLimits[j]).arg(histogram[i][j]);
+        }
+        logMessage(tr("Tick: %1 avg %2us max %3us |%4")
+                   .arg(phaseNames[i]).arg(totalTime[i]/1000/nTicks).arg(maxTime[i]/1000).arg(buckets));
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SERVERTICK_H
+#define SERVERTICK_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMutex>
+#include <functional>
+
+#define TICK_MAX_CATCHUP 3 // Max number of late ticks we run back to back before giving up on them
+#define TICK_HISTOGRAM_BUCKETS 9
+
+class Sync;
+class Player;
+
+/// Fixed timestep game loop. Each tick runs the phases of the server's work in order:
+/// read the pending datagrams, run the simulation, build the sync, flush the grouped messages.
+class ServerTick : public QObject
+{
+    Q_OBJECT
+public:
+    enum Phase
+    {
+        Input,
+        Simulation,
+        SyncBuild,
+        Output,
+        PhaseCount
+    };
+
+public:
+    explicit ServerTick(Sync* Sync, QObject* parent = 0);
+    void start(int tickInterval, int syncInterval, int pingCheckInterval);
+    void stop();
+    void printStats(); ///< Logs the tick counters and the per-phase timing histograms
+    void resetStats();
+    static void post(std::function<void()> task); ///< Queues cross-scene work (scene transfers, ...) for the main thread's next simulation phase
+    static void post(Player* player, std::function<void()> task); ///< Same, but dropped if the player disconnects first
+
+public slots:
+    void run(); ///< Runs the ticks that are due, then schedules the next one
+
+private:
+    void runTick(); ///< Runs every phase once
+    void record(Phase phase, qint64 nsecs);
+    static void runPosted();
+
+public:
+    static const char* phaseNames[PhaseCount];
+    static const int bucketLimits[TICK_HISTOGRAM_BUCKETS]; // Upper bound of each histogram bucket, in us
+
+private:
+    static QVector<std::function<void()>> posted; // Work that changes more than one scene, ran between the scene jobs
+    static QMutex postedMutex;
+
+private:
+    Sync* sync;
+    QTimer* tickTimer;
+    QElapsedTimer clock;
+    qint64 nextTick; // Time of the next tick on clock, in ms
+    qint64 nextSync; // Time of the next sync on clock, in ms
+    qint64 nextPingCheck; // Time of the next ping timeouts check on clock, in ms
+    int interval, syncInterval, pingCheckInterval;
+
+    quint64 nTicks; // Number of ticks ran
+    quint64 nOverruns; // Number of ticks that took longer than the interval
+    quint64 nSkipped; // Number of ticks dropped because we were too late to catch up
+    quint64 histogram[PhaseCount][TICK_HISTOGRAM_BUCKETS];
+    qint64 maxTime[PhaseCount]; // Slowest run of each phase, in ns
+    qint64 totalTime[PhaseCount]; // Sum of the time of each phase, in ns
+};
+
+#endif // SERVERTICK_H
@@ -18,6 +18,21 @@ int Settings::daysToPurge; // time since last logon before removing player
 bool Settings::enableLoginServer; // Starts a login server
 bool Settings::enableGameServer; // Starts a game server
 bool Settings::enableMultiplayer; // Sync players' positions
+int Settings::tickInterval; // Time in ms between two ticks of the game loop
+int Settings::syncKeepalive; // Time in ms before we resend the position of an entity that didn't move
+int Settings::syncRadius; // Players only get the sync of entities within this distance. 0 to sync the whole scene
+int Settings::syncHysteresis; // Percentage of syncRadius an entity must move past it before we stop syncing it
+int Settings::syncNearRadius; // Entities closer than this are synced on every sync tick
+int Settings::syncMidRadius; // Entities closer than this are synced every syncMidInterval ticks
+int Settings::syncMidInterval; // Number of sync ticks between two syncs of a mid-range entity
+int Settings::syncFarInterval; // Number of sync ticks between two syncs of an entity past syncMidRadius
+int Settings::maxMoveSpeed; // Fastest a pony can move horizontally, in units per second. 0 to disable the speed check
+int Settings::maxScenePlayers; // Players in a scene before we open another instance of it. 0 for no cap
+int Settings::streamRadius; // Entities are instantiated on a client once they're within this distance. 0 to instantiate the whole scene on load
+int Settings::streamBudget; // Max number of entities instantiated per player per sync tick, the nearest first
+int Settings::maxConcurrentLoads; // Players loading a scene at the same time, the others wait in the queue. 0 for no limit
+int Settings::loadBandwidth; // KB/s of reliable messages we allow for the players loading a scene. 0 for no limit
+int Settings::mobAiBudget; // Time in us the mob AI of each scene can use per tick, the other mobs wait for the next ticks. 0 to disable the mob AI
 bool Settings::enableGetlog; // Enable GET /log requests
 bool Settings::enablePVP; // Enables player versus player fights
 bool Settings::autostartClient; // Enables Game Client autostart
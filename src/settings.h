@@ -23,6 +23,21 @@
 #define DEFAULT_GAME_PORT 1039
 #define DEFAULT_ENABLE_MULTIPLAYER true
 #define DEFAULT_SYNC_INTERVAL 200
+#define DEFAULT_TICK_INTERVAL 25
+#define DEFAULT_SYNC_KEEPALIVE 3000
+#define DEFAULT_SYNC_RADIUS 300
+#define DEFAULT_SYNC_HYSTERESIS 20
+#define DEFAULT_SYNC_NEAR_RADIUS 60
+#define DEFAULT_SYNC_MID_RADIUS 150
+#define DEFAULT_SYNC_MID_INTERVAL 3
+#define DEFAULT_SYNC_FAR_INTERVAL 10
+#define DEFAULT_MAX_MOVE_SPEED 50
+#define DEFAULT_MAX_SCENE_PLAYERS 0
+#define DEFAULT_STREAM_RADIUS 400
+#define DEFAULT_STREAM_BUDGET 10
+#define DEFAULT_MAX_CONCURRENT_LOADS 16
+#define DEFAULT_LOAD_BANDWIDTH 256
+#define DEFAULT_MOB_AI_BUDGET 2000
 #define DEFAULT_PING_TIMEOUT 25
 #define DEFAULT_PING_CHECK 3000
 #define DEFAULT_ENABLE_PVP false
@@ -49,6 +64,21 @@ extern int daysToPurge; // time since last logon before removing player
 extern bool enableLoginServer; // Starts a login server
 extern bool enableGameServer; // Starts a game server
 extern bool enableMultiplayer; // Sync players' positions
+extern int tickInterval; // Time in ms between two ticks of the game loop
+extern int syncKeepalive; // Time in ms before we resend the position of an entity that didn't move
+extern int syncRadius; // Players only get the sync of entities within this distance. 0 to sync the whole scene
+extern int syncHysteresis; // Percentage of syncRadius an entity must move past it before we stop syncing it
+extern int syncNearRadius; // Entities closer than this are synced on every sync tick
+extern int syncMidRadius; // Entities closer than this are synced every syncMidInterval ticks
+extern int syncMidInterval; // Number of sync ticks between two syncs of a mid-range entity
+extern int syncFarInterval; // Number of sync ticks between two syncs of an entity past syncMidRadius
+extern int maxMoveSpeed; // Fastest a pony can move horizontally, in units per second. 0 to disable the speed check
+extern int maxScenePlayers; // Players in a scene before we open another instance of it. 0 for no cap
+extern int streamRadius; // Entities are instantiated on a client once they're within this distance. 0 to instantiate the whole scene on load
+extern int streamBudget; // Max number of entities instantiated per player per sync tick, the nearest first
+extern int maxConcurrentLoads; // Players loading a scene at the same time, the others wait in the queue. 0 for no limit
+extern int loadBandwidth; // KB/s of reliable messages we allow for the players loading a scene. 0 for no limit
+extern int mobAiBudget; // Time in us the mob AI of each scene can use per tick, the other mobs wait for the next ticks. 0 to disable the mob AI
 extern bool enableGetlog; // Enable GET /log requests
 extern bool enablePVP; // Enables player versus player fights
 extern bool autostartClient; // Enables Game Client autostart
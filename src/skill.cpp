@@ -2,10 +2,14 @@
 #include "statsComponent.h"
 #include "app.h"
 #include "animation.h"
-#include <QTimer>
+#include "utils.h"
+#include "scene.h"
+#include "mob.h"
+#include "proximity.h"
 #include <QObject>
 
 QMap<unsigned, Skill> Skill::skills;
+QVector<DamageOverTime> Skill::activeEffects;
 
 SkillTargetEffect::SkillTargetEffect()
     : stat{SkillTargetStat::Health}, targets{SkillTarget::Enemy},
@@ -58,24 +62,12 @@ void Skill::applySkillEffect(SkillTargetEffect& effect, StatsComponent& target,
         return;
     if (effect.isDPS)
     {
-        QTimer* dps = new QTimer;
-        dps->setInterval(1000);
-        dps->setSingleShot(true);
-        float *duration = new float{effect.duration};
-        QObject::connect(dps, &QTimer::timeout, [effect, dps, duration, &target](){
-            if (effect.stat == SkillTargetStat::Health)
-                target.takeDamage(effect.amount);
-
-            *duration -= 1;
-            if (*duration > 0)
-                dps->start();
-            else
-            {
-                delete dps;
-                delete duration;
-            }
-        });
-        dps->start();
+        DamageOverTime dot;
+        dot.target = &target;
+        dot.effect = effect;
+        dot.remaining = effect.duration;
+        dot.nextTick = timestampNow() + 1;
+        activeEffects << dot;
     }
     else
     {
@@ -83,3 +75,91 @@ void Skill::applySkillEffect(SkillTargetEffect& effect, StatsComponent& target,
             target.takeDamage(effect.amount);
     }
 }
+
+bool Skill::isInRange(unsigned skillId, unsigned upgradeId, const UVector& casterPos, const UVector& targetPos)
+{
+    if (!skills.contains(skillId) || !skills[skillId].upgrades.contains(upgradeId))
+        return false;
+    const SkillUpgrade& upgrade = skills[skillId].upgrades[upgradeId];
+
+    float dx = targetPos.x - casterPos.x;
+    float dy = targetPos.y - casterPos.y;
+    float dz = targetPos.z - casterPos.z;
+    float range = upgrade.targetDistance + SKILL_RANGE_TOLERANCE;
+    return dx*dx + dy*dy + dz*dz <= range*range;
+}
+
+void Skill::applySplash(unsigned skillId, unsigned upgradeId, Scene* scene, const UVector& center, const SceneEntity* target)
+{
+    if (!scene || !skills.contains(skillId) || !skills[skillId].upgrades.contains(upgradeId))
+        return;
+    const SkillUpgrade& upgrade = skills[skillId].upgrades[upgradeId];
+    if (!upgrade.AoERadius || upgrade.splashEffects.isEmpty())
+        return;
+
+    static QVector<int> near; // Only used from the main thread
+    static QVector<Mob*> splashed;
+    near.clear();
+    splashed.clear();
+    Proximity::inRadius(scene->entities, center, upgrade.AoERadius, EntityStore::MobEntity, near);
+    for (int index : near)
+    {
+        if (upgrade.maxSplashCount && splashed.size() >= (int)upgrade.maxSplashCount)
+            break;
+        Mob* mob = static_cast<Mob*>(scene->entities.entities[index]);
+        if (mob != target)
+            splashed << mob;
+    }
+
+    // Not while we read the store, a mob that dies respawns somewhere else
+    for (Mob* mob : splashed)
+        applySkill(skillId, *mob, SkillTarget::Enemy, upgradeId, true);
+}
+
+void Skill::collectEffects(float now)
+{
+    for (int i=0; i<activeEffects.size();)
+    {
+        DamageOverTime& dot = activeEffects[i];
+        if (dot.nextTick > now)
+        {
+            i++;
+            continue;
+        }
+
+        if (dot.effect.stat == SkillTargetStat::Health)
+        {
+            // Each scene's job applies its own damage, a target that isn't in a scene can take it here
+            SceneEntity* entity = dynamic_cast<SceneEntity*>(dot.target);
+            if (entity && entity->scene)
+                entity->scene->dueDamage << qMakePair(dot.target, dot.effect.amount);
+            else
+                dot.target->takeDamage(dot.effect.amount);
+        }
+        dot.remaining -= 1;
+        dot.nextTick += 1;
+        if (dot.remaining > 0)
+            i++;
+        else
+            activeEffects.removeAt(i);
+    }
+}
+
+void Skill::applyDueDamage(Scene& scene)
+{
+    // Nothing deletes the targets between collectEffects and the scene jobs
+    for (const QPair<StatsComponent*, float>& damage : scene.dueDamage)
+        damage.first->takeDamage(damage.second);
+    scene.dueDamage.clear();
+}
+
+void Skill::cancelEffects(StatsComponent* target)
+{
+    for (int i=0; i<activeEffects.size();)
+    {
+        if (activeEffects[i].target == target)
+            activeEffects.removeAt(i);
+        else
+            i++;
+    }
+}
@@ -3,9 +3,15 @@
 
 #include <QMap>
 #include <QVector>
+#include <QPair>
+#include "dataType.h"
+
+#define SKILL_RANGE_TOLERANCE 2 // The positions of the client and the server never match exactly
 
 class Animation;
 class StatsComponent;
+class Scene;
+struct SceneEntity;
 
 enum class SkillTargetStat
 {
@@ -37,6 +43,16 @@ public:
     float duration;
 };
 
+/// An effect applied once per second for its duration
+struct DamageOverTime
+{
+public:
+    StatsComponent* target;
+    SkillTargetEffect effect;
+    float remaining; ///< Seconds of effect left
+    float nextTick; ///< timestampNow() of the next application
+};
+
 struct SkillUpgrade
 {
 public:
@@ -103,6 +119,14 @@ public:
     static bool applySkill(unsigned skillId, StatsComponent& target, SkillTarget targetType,
                            unsigned upgradeId=0, bool splashOnly=false);
 
+    // Whether targetPos is close enough to casterPos for this skill upgrade
+    static bool isInRange(unsigned skillId, unsigned upgradeId, const UVector& casterPos, const UVector& targetPos);
+    // Applies the splash effects to the mobs within the AoE radius of center, except the skill's target
+    static void applySplash(unsigned skillId, unsigned upgradeId, Scene* scene, const UVector& center, const SceneEntity* target);
+    static void collectEffects(float now); ///< Hands the damage over time that's due to the target's scene. Called by the server tick
+    static void applyDueDamage(Scene& scene); ///< Applies what collectEffects gave the scene, in its SceneSimulationJob
+    static void cancelEffects(StatsComponent* target); ///< Drops the effects on this target, it's about to be deleted
+
 private:
     static void applySkillEffect(SkillTargetEffect& effect, StatsComponent& target, SkillTarget targetType);
 
@@ -115,6 +139,7 @@ public:
 
 public:
     static QMap<unsigned, Skill> skills; // Maps skill ids to skills
+    static QVector<DamageOverTime> activeEffects; // Damage over time effects currently running
 };
 
 #endif // SKILL_H
@@ -0,0 +1,110 @@
+#include "spatialGrid.h"
+#include "player.h"
+#include <cmath>
+
+SpatialGrid::SpatialGrid()
+    : cellSize{100}
+{
+}
+
+void SpatialGrid::setCellSize(float size)
+{
+    if (size <= 0 || size == cellSize)
+        return;
+    cellSize = size;
+
+    QList<Player*> players = cellOf.keys();
+    cells.clear();
+    cellOf.clear();
+    for (Player* player : players)
+        insert(player, player->pony.pos);
+}
+
+quint64 SpatialGrid::key(int cx, int cz)
+{
+    return ((quint64)(quint32)cx << 32) | (quint32)cz;
+}
+
+int SpatialGrid::cellCoord(float v) const
+{
+    return cellCoord(v, cellSize);
+}
+
+int SpatialGrid::cellCoord(float v, float cellSize)
+{
+    return (int)std::floor(v / cellSize);
+}
+
+void SpatialGrid::insert(Player* player, const UVector& pos)
+{
+    if (cellOf.contains(player))
+    {
+        update(player, pos);
+        return;
+    }
+    quint64 k = key(cellCoord(pos.x), cellCoord(pos.z));
+    cells[k] << player;
+    cellOf.insert(player, k);
+}
+
+void SpatialGrid::remove(Player* player)
+{
+    auto it = cellOf.find(player);
+    if (it == cellOf.end())
+        return;
+
+    auto cell = cells.find(it.value());
+    if (cell != cells.end())
+    {
+        cell->removeOne(player);
+        if (cell->isEmpty())
+            cells.erase(cell);
+    }
+    cellOf.erase(it);
+}
+
+void SpatialGrid::update(Player* player, const UVector& pos)
+{
+    quint64 k = key(cellCoord(pos.x), cellCoord(pos.z));
+    auto it = cellOf.find(player);
+    if (it == cellOf.end())
+    {
+        insert(player, pos);
+        return;
+    }
+    if (it.value() == k)
+        return;
+
+    remove(player);
+    cells[k] << player;
+    cellOf.insert(player, k);
+}
+
+void SpatialGrid::query(const UVector& pos, float radius, QVector<Player*>& result) const
+{
+    int minX = cellCoord(pos.x - radius), maxX = cellCoord(pos.x + radius);
+    int minZ = cellCoord(pos.z - radius), maxZ = cellCoord(pos.z + radius);
+
+    // With a huge radius it's faster to look at every non-empty cell
+    if ((qint64)(maxX-minX+1)*(maxZ-minZ+1) > cells.size())
+    {
+        for (auto cell = cells.constBegin(); cell != cells.constEnd(); ++cell)
+            result += *cell;
+        return;
+    }
+
+    for (int cx = minX; cx <= maxX; cx++)
+    {
+        for (int cz = minZ; cz <= maxZ; cz++)
+        {
+            auto cell = cells.constFind(key(cx, cz));
+            if (cell != cells.constEnd())
+                result += *cell;
+        }
+    }
+}
+
+int SpatialGrid::size() const
+{
+    return cellOf.size();
+}
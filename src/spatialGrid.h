@@ -0,0 +1,34 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QHash>
+#include <QVector>
+#include "dataType.h"
+
+class Player;
+
+/// Hash grid of the players of a scene on the horizontal (x,z) plane.
+/// Only the non-empty cells are stored, so the size of the scene doesn't matter.
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+    void setCellSize(float size); ///< Changes the cell size and rebuilds the grid
+    void insert(Player* player, const UVector& pos); ///< Adds the player, or moves it if it's already in the grid
+    void remove(Player* player);
+    void update(Player* player, const UVector& pos); ///< Moves the player if it changed cell. Cheap if it didn't.
+    void query(const UVector& pos, float radius, QVector<Player*>& result) const; ///< Appends the players in the cells touching the radius (not filtered by distance)
+    int size() const;
+    static quint64 key(int cx, int cz); ///< Key of a cell, for the other grids of entities kept as sorted (key, entity) arrays
+    static int cellCoord(float v, float cellSize);
+
+private:
+    int cellCoord(float v) const;
+
+private:
+    float cellSize;
+    QHash<quint64, QVector<Player*>> cells;
+    QHash<Player*, quint64> cellOf; // Current cell of each player
+};
+
+#endif // SPATIALGRID_H
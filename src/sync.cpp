@@ -4,73 +4,252 @@
 #include "message.h"
 #include "utils.h"
 #include "serialize.h"
+#include "settings.h"
+#include "app.h"
+#include "entityStreaming.h"
+#include "mob.h"
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
 
-Sync::Sync(QObject *parent) : QObject(parent)
+Sync::Sync(QObject *parent) : QObject(parent), nSent{0}, nSuppressed{0}, nDeferred{0}, tick{0}
 {
-    syncTimer = new QTimer(this);
-    connect(syncTimer, SIGNAL(timeout()), this, SLOT(doSync()));
 }
 
-void Sync::startSync(int syncInterval)
+void Sync::doSync()
 {
-    syncTimer->start(syncInterval);
-}
+    tick++;
 
-void Sync::stopSync()
-{
-    syncTimer->stop();
+    int nJobs = 0;
+    for (int i=0; i<Scene::scenes.size(); i++)
+    {
+        const Scene& scene = Scene::scenes[i];
+        if (scene.players.isEmpty() || (scene.players.size()<2 && scene.mobs.isEmpty())) // Nothing that moves for someone to see
+            continue;
+        if (nJobs == jobs.size())
+            jobs.resize(nJobs+1);
+        SceneSyncJob& job = jobs[nJobs++];
+        job.scene = &Scene::scenes[i];
+        job.outbox.clear();
+        job.nSent = job.nSuppressed = job.nDeferred = 0;
+    }
+    jobs.resize(nJobs);
+
+    // The scenes don't share players, so they can be built in parallel.
+    // The main thread waits here, nothing else touches the players meanwhile.
+    if (nJobs > 1)
+        QtConcurrent::blockingMap(jobs, [this](SceneSyncJob& job){syncScene(job);});
+    else if (nJobs == 1)
+        syncScene(jobs[0]);
+
+    // The socket isn't thread safe, the datagrams are sent here on the main thread
+    for (SceneSyncJob& job : jobs)
+    {
+        for (const QPair<Player*, QByteArray>& datagram : job.outbox)
+            sendDatagram(datagram.first, datagram.second);
+        nSent += job.nSent;
+        nSuppressed += job.nSuppressed;
+        nDeferred += job.nDeferred;
+    }
 }
 
-void Sync::doSync()
+void Sync::syncScene(SceneSyncJob& job) const
 {
-   for (int i=0; i<Scene::scenes.size(); i++)
+    float enterRadius = Settings::syncRadius;
+    float leaveRadius = enterRadius * (100 + Settings::syncHysteresis) / 100;
+    QVector<Player*> candidates;
+    QSet<quint16> interest;
+    Scene& scene = *job.scene;
+    scene.grid.setCellSize(leaveRadius);
+    bool streaming = EntityStreaming::isEnabled();
+
+    // Level of detail, the scene can override the server's defaults
+    float nearRadius = scene.syncNearRadius >= 0 ? scene.syncNearRadius : Settings::syncNearRadius;
+    float midRadius = scene.syncMidRadius >= 0 ? scene.syncMidRadius : Settings::syncMidRadius;
+    int midInterval = scene.syncMidInterval > 0 ? scene.syncMidInterval : Settings::syncMidInterval;
+    int farInterval = scene.syncFarInterval > 0 ? scene.syncFarInterval : Settings::syncFarInterval;
+
+    // Encode: one record per entity, every receiver gets the same bytes
+    float now = timestampNow();
+    for (Player* player : scene.players) // Like the mobs, a pony that didn't move keeps its record
+    {
+        if (player->syncRecordVersion == player->pony.syncVersion && !player->syncRecord.isEmpty())
+            continue;
+        player->syncRecord = buildSyncMessage(player->pony, &scene, now);
+        player->syncRecordVersion = player->pony.syncVersion;
+    }
+    for (Mob* mob : scene.mobs) // Most mobs don't move, keep their record until they do
     {
-        if (Scene::scenes[i].players.size()<2)
+        if (mob->dead)
             continue;
-        //logMessage("Syncing "+ QString().setNum(Scene::scenes[i].players.size()) +" players in scene "+ Scene::scenes[i].name);
-        for (int j=0; j < Scene::scenes[i].players.size(); j++)
+        if (mob->syncRecordVersion == mob->syncVersion && !mob->syncRecord.isEmpty())
+            continue;
+        mob->syncRecord = buildSyncMessage(*mob, &scene, now);
+        mob->syncRecordVersion = mob->syncVersion;
+    }
+
+    // The mobs by cell, like the ponies in scene.grid. Each receiver only looks at the cells around it
+    job.mobCells.clear();
+    if (enterRadius > 0)
+    {
+        for (Mob* mob : scene.mobs)
+            if (!mob->dead)
+                job.mobCells << qMakePair(SpatialGrid::key(SpatialGrid::cellCoord(mob->pos.x, leaveRadius), SpatialGrid::cellCoord(mob->pos.z, leaveRadius)), mob);
+        std::sort(job.mobCells.begin(), job.mobCells.end(),
+                  [](const QPair<quint64, Mob*>& a, const QPair<quint64, Mob*>& b){return a.first < b.first;});
+    }
+
+    //logMessage("Syncing "+ QString().setNum(scene.players.size()) +" players in scene "+ scene.name);
+    for (int j=0; j < scene.players.size(); j++)
+    {
+        Player* dest = scene.players[j];
+        QByteArray datagram; // All the records for dest, packed with their headers
+        candidates.clear();
+        interest.clear();
+        if (enterRadius > 0)
+            scene.grid.query(dest->pony.pos, leaveRadius, candidates);
+        else // Area of interest disabled, sync the whole scene
+            candidates = scene.players.toVector();
+
+        // Whether dest should get the sync of this entity now. Same rules for the ponies and the mobs
+        auto wanted = [&](const SceneEntity& source)
         {
-            for (int k=0; k < Scene::scenes[i].players.size(); k++)
+            if (streaming && !dest->knownEntities.contains(source.netviewId)) // Not instantiated on the client yet
+                return false;
+            float dx = source.pos.x - dest->pony.pos.x;
+            float dz = source.pos.z - dest->pony.pos.z;
+            float dist2 = dx*dx + dz*dz;
+            if (enterRadius > 0)
             {
-                if (j==k)
-                    continue;
-
-                // sending sync to self before sync: no client updates positions
-                // sending sync to self after sync: clients sync correctly across all players (tested with 2-5 ponies)
-                // sending sync to self only with odd number of ponies in scene: clients sync correctly across all players (tested with 2-6 ponies)
-                sendSyncMessage(Scene::scenes[i].players[k], Scene::scenes[i].players[j]);                
-                //sendSyncMessage(Scene::scenes[i].players[j], Scene::scenes[i].players[j]); //works for up to 4 ponies
+                // An entity enters the area of interest at enterRadius, but only leaves it past leaveRadius
+                // so that entities on the edge don't flicker in and out
+                float radius = dest->syncInterest.contains(source.netviewId) ? leaveRadius : enterRadius;
+                if (dist2 > radius*radius)
+                    return false;
+                interest.insert(source.netviewId);
             }
-            if (Scene::scenes[i].players.size() % 2)
+
+            // Near entities are synced every tick, the others every few ticks.
+            // The netviewId staggers them so they don't all go out on the same tick.
+            int interval = 1;
+            if (dist2 > midRadius*midRadius)
+                interval = farInterval;
+            else if (dist2 > nearRadius*nearRadius)
+                interval = midInterval;
+            if (interval > 1 && (tick + source.netviewId) % interval
+                    && dest->lastSyncSent.contains(source.netviewId))
+            {
+                job.nDeferred++;
+                return false;
+            }
+            return true;
+        };
+
+        for (Player* source : candidates)
+        {
+            if (source == dest || !wanted(source->pony))
+                continue;
+
+            // sending sync to self before sync: no client updates positions
+            // sending sync to self after sync: clients sync correctly across all players (tested with 2-5 ponies)
+            // sending sync to self only with odd number of ponies in scene: clients sync correctly across all players (tested with 2-6 ponies)
+            syncIfChanged(source->pony, source->syncRecord, dest, job, datagram);
+            //sendSyncMessage(scene.players[j], scene.players[j]); //works for up to 4 ponies
+        }
+
+        // The mobs the mob AI moved. The ones that never moved are suppressed like any entity that didn't move
+        if (enterRadius > 0)
+        {
+            const QVector<QPair<quint64, Mob*>>& cells = job.mobCells;
+            int cx = SpatialGrid::cellCoord(dest->pony.pos.x, leaveRadius), cz = SpatialGrid::cellCoord(dest->pony.pos.z, leaveRadius);
+            for (int x=cx-1; x<=cx+1; x++)
             {
-                //logMessage ("making odd numbers of ponies work?");
-                sendSyncMessage(Scene::scenes[i].players[j], Scene::scenes[i].players[j]); //makes only odd number of ponies work
+                for (int z=cz-1; z<=cz+1; z++)
+                {
+                    quint64 key = SpatialGrid::key(x, z);
+                    auto it = std::lower_bound(cells.begin(), cells.end(), key,
+                                               [](const QPair<quint64, Mob*>& cell, quint64 key){return cell.first < key;});
+                    for (; it != cells.end() && it->first == key; ++it)
+                        if (wanted(*it->second))
+                            syncIfChanged(*it->second, it->second->syncRecord, dest, job, datagram);
+                }
             }
         }
+        else
+        {
+            for (const Mob* mob : scene.mobs)
+                if (!mob->dead && wanted(*mob))
+                    syncIfChanged(*mob, mob->syncRecord, dest, job, datagram);
+        }
+
+        if (enterRadius > 0)
+        {
+            // Forget what we sent about the entities that left, so they're synced as soon as they come back
+            for (quint16 netviewId : dest->syncInterest)
+                if (!interest.contains(netviewId))
+                    dest->lastSyncSent.remove(netviewId);
+            dest->syncInterest.swap(interest);
+        }
+        if (scene.players.size() % 2 && scene.players.size() > 1) // A pony alone in a scene is only synced for the mobs
+        {
+            //logMessage ("making odd numbers of ponies work?");
+            syncIfChanged(dest->pony, dest->syncRecord, dest, job, datagram); //makes only odd number of ponies work
+        }
+        if (!datagram.isEmpty())
+            job.outbox << qMakePair(dest, datagram);
     }
 }
 
-void Sync::sendSyncMessage(Player* source, Player* dest)
+void Sync::syncIfChanged(const SceneEntity& source, const QByteArray& record, Player* dest, SceneSyncJob& job, QByteArray& datagram) const
+{
+    float now = timestampNow();
+    auto it = dest->lastSyncSent.find(source.netviewId);
+    if (it != dest->lastSyncSent.end() && it->version == source.syncVersion
+            && (now - it->time)*1000 < Settings::syncKeepalive)
+    {
+        job.nSuppressed++;
+        return;
+    }
+
+    // Fan out: copy the shared record in dest's datagram. Dest belongs to this job's scene, so we can take its sequence numbers here
+    if (datagram.size() + 5 + record.size() > SYNC_DATAGRAM_MAX)
+    {
+        job.outbox << qMakePair(dest, datagram);
+        datagram.clear();
+    }
+    appendUnreliableMessage(dest, datagram, record);
+    job.nSent++;
+    SyncCacheEntry entry;
+    entry.version = source.syncVersion;
+    entry.time = now;
+    dest->lastSyncSent.insert(source.netviewId, entry);
+}
+
+QByteArray Sync::buildSyncMessage(const SceneEntity& source, const Scene* scene, float time)
 {
     QByteArray data(2,0);
-    data[0] = (quint8)(source->pony.netviewId&0xFF);
-    data[1] = (quint8)((source->pony.netviewId>>8)&0xFF);
-    data += floatToData(timestampNow());
-    //data += rangedSingleToData(source.pony.pos.x, XMIN, XMAX, PosRSSize);
-    //data += rangedSingleToData(source.pony.pos.y, YMIN, YMAX, PosRSSize);
-    //data += rangedSingleToData(source.pony.pos.z, ZMIN, ZMAX, PosRSSize);
-    data += floatToData(source->pony.pos.x);
-    data += floatToData(source->pony.pos.y);
-    data += floatToData(source->pony.pos.z);
-    data += rangedSingleToData(source->pony.rot.y, ROTMIN, ROTMAX, RotRSSize);
-//    data += rangedSingleToData(source->pony.rot.x, ROTMIN, ROTMAX, RotRSSize);
-//    data += rangedSingleToData(source->pony.rot.z, ROTMIN, ROTMAX, RotRSSize);
-    sendMessage(dest, MsgUserUnreliable, data);
-
-    //logMessage(QObject::tr("UDP: Syncing %1 to %2").arg(source->pony.netviewId).arg(dest->pony.netviewId));
+    data[0] = (quint8)(source.netviewId&0xFF);
+    data[1] = (quint8)((source.netviewId>>8)&0xFF);
+    data += floatToData(time);
+    if (scene->quantizedSync)
+    {
+        // 6 bytes instead of 12, the scene bounds come from its vortex file
+        data += rangedSingleToData(source.pos.x, scene->boundsMin.x, scene->boundsMax.x, PosRSSize);
+        data += rangedSingleToData(source.pos.y, scene->boundsMin.y, scene->boundsMax.y, PosRSSize);
+        data += rangedSingleToData(source.pos.z, scene->boundsMin.z, scene->boundsMax.z, PosRSSize);
+    }
+    else
+    {
+        data += floatToData(source.pos.x);
+        data += floatToData(source.pos.y);
+        data += floatToData(source.pos.z);
+    }
+    data += rangedSingleToData(source.rot.y, ROTMIN, ROTMAX, RotRSSize);
+//    data += rangedSingleToData(source.rot.x, ROTMIN, ROTMAX, RotRSSize);
+//    data += rangedSingleToData(source.rot.z, ROTMIN, ROTMAX, RotRSSize);
+    return data;
+
+    //logMessage(QObject::tr("UDP: Syncing %1 to %2").arg(source.netviewId).arg(dest->pony.netviewId));
 }
-// TODO: Test ranged singles on PonyVille with the bounds from the text assets
-// Or maybe test the command that gives the bounds to the clients
 
 void Sync::receiveSync(Player* player, QByteArray data) // Receives the 01 updates from each players
 {
@@ -78,6 +257,9 @@ void Sync::receiveSync(Player* player, QByteArray data) // Receives the 01 updat
         return;
     //app.logMessage("Got sync from "+QString().setNum(player->pony.netviewId));
 
+    UVector oldPos = player->pony.pos;
+    UQuaternion oldRot = player->pony.rot;
+
     // 5 and 6 are id and id>>8
     player->pony.pos.x = dataToFloat(data.mid(11));
     player->pony.pos.y = dataToFloat(data.mid(15));
@@ -90,4 +272,21 @@ void Sync::receiveSync(Player* player, QByteArray data) // Receives the 01 updat
         player->pony.rot.x = dataToRangedSingle(ROTMIN, ROTMAX, RotRSSize, data.mid(24,1));
         player->pony.rot.z = dataToRangedSingle(ROTMIN, ROTMAX, RotRSSize, data.mid(25,1));
     }
+
+    if (player->pony.pos.x != oldPos.x || player->pony.pos.y != oldPos.y || player->pony.pos.z != oldPos.z
+            || player->pony.rot.x != oldRot.x || player->pony.rot.y != oldRot.y || player->pony.rot.z != oldRot.z)
+    {
+        player->pony.markSyncDirty();
+        player->pony.history.push(timestampNow(), player->pony.pos, player->pony.rot, app.syncInterval / 1000.f);
+        Scene* scene = player->pony.scene;
+        if (scene)
+        {
+            scene->grid.update(player, player->pony.pos);
+            if (!player->pendingValidation) // Checked with the other moves of the tick, see MoveValidation
+            {
+                player->pendingValidation = true;
+                scene->movedPlayers << player;
+            }
+        }
+    }
 }
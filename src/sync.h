@@ -15,25 +15,48 @@
 #define PosRSSize 16
 #define RotRSSize 8
 
-#include <QTimer>
+#define SYNC_DATAGRAM_MAX 1024 // Max size of a datagram of packed sync messages, same as the reliable group buffer
+
 #include <QObject>
+#include <QVector>
+#include <QPair>
 #include "player.h"
 
+class Scene;
+class Mob;
+
+/// Sync work of one scene. Built by a worker thread, sent by the main thread
+struct SceneSyncJob
+{
+    Scene* scene;
+    QVector<QPair<Player*, QByteArray>> outbox; // Datagrams of packed sync messages, and who to send them to
+    QVector<QPair<quint64, Mob*>> mobCells; // Live mobs of the scene sorted by cell of the area of interest, rebuilt every sync
+    quint64 nSent, nSuppressed, nDeferred;
+};
+
 class Sync : public QObject
 {
     Q_OBJECT
 public:
     explicit Sync(QObject* parent = 0);
-    void startSync(int syncInterval);
-    void stopSync();
-    void sendSyncMessage(Player *source, Player *dest);
+    static QByteArray buildSyncMessage(const SceneEntity& source, const Scene* scene, float time); ///< Sync record of a pony or a mob
     static void receiveSync(Player* player, QByteArray data);
 
 public slots:
-    void doSync();
+    void doSync(); ///< Builds the sync of every scene in parallel, then sends it
+
+private:
+    void syncScene(SceneSyncJob& job) const; ///< Only touches the scene's own players and mobs, runs on a worker thread
+    void syncIfChanged(const SceneEntity& source, const QByteArray& record, Player *dest, SceneSyncJob& job, QByteArray& datagram) const; ///< Packs the source's record only if dest doesn't know its position yet
+
+public:
+    quint64 nSent; // Number of sync messages sent
+    quint64 nSuppressed; // Number of sync messages skipped because the entity didn't move
+    quint64 nDeferred; // Number of sync messages left for a later tick because the entity is far away
 
 private:
-    QTimer* syncTimer;
+    quint32 tick; // Number of doSync so far, schedules the mid and far entities
+    QVector<SceneSyncJob> jobs; // Kept between syncs to reuse the outboxes' memory
 };
 
 
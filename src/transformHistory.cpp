@@ -0,0 +1,94 @@
+#include "transformHistory.h"
+#include <cmath>
+
+#define TWO_PI 6.283185f
+
+// The angles are in ±2π, interpolate them along the shortest arc
+static float lerpAngle(float a, float b, float t)
+{
+    float delta = fmod(b - a, TWO_PI);
+    if (delta > TWO_PI/2)
+        delta -= TWO_PI;
+    else if (delta < -TWO_PI/2)
+        delta += TWO_PI;
+    return a + delta * t;
+}
+
+TransformHistory::TransformHistory()
+    : head{0}, count{0}
+{
+}
+
+void TransformHistory::push(float time, const UVector& pos, const UQuaternion& rot, float maxGap)
+{
+    if (count && maxGap > 0)
+    {
+        const Transform& last = samples[(head + TRANSFORM_HISTORY_SIZE - 1) % TRANSFORM_HISTORY_SIZE];
+        if (time - last.time > maxGap)
+        {
+            Transform still = last; // Copy, append may overwrite it
+            append(time - maxGap, still.pos, still.rot);
+        }
+    }
+    append(time, pos, rot);
+}
+
+void TransformHistory::append(float time, const UVector& pos, const UQuaternion& rot)
+{
+    Transform& sample = samples[head];
+    sample.time = time;
+    sample.pos = pos;
+    sample.rot = rot;
+    head = (head + 1) % TRANSFORM_HISTORY_SIZE;
+    if (count < TRANSFORM_HISTORY_SIZE)
+        count++;
+}
+
+bool TransformHistory::at(float time, UVector& pos, UQuaternion& rot) const
+{
+    if (!count)
+        return false;
+
+    // Walk back from the newest sample until we find the first one older than time
+    int newer = (head + TRANSFORM_HISTORY_SIZE - 1) % TRANSFORM_HISTORY_SIZE;
+    if (time >= samples[newer].time)
+    {
+        pos = samples[newer].pos;
+        rot = samples[newer].rot;
+        return true;
+    }
+    for (int i=1; i<count; i++)
+    {
+        int older = (newer + TRANSFORM_HISTORY_SIZE - 1) % TRANSFORM_HISTORY_SIZE;
+        const Transform& a = samples[older];
+        const Transform& b = samples[newer];
+        if (time >= a.time)
+        {
+            float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1;
+            pos.x = a.pos.x + (b.pos.x - a.pos.x) * t;
+            pos.y = a.pos.y + (b.pos.y - a.pos.y) * t;
+            pos.z = a.pos.z + (b.pos.z - a.pos.z) * t;
+            rot.x = lerpAngle(a.rot.x, b.rot.x, t);
+            rot.y = lerpAngle(a.rot.y, b.rot.y, t);
+            rot.z = lerpAngle(a.rot.z, b.rot.z, t);
+            rot.w = a.rot.w + (b.rot.w - a.rot.w) * t;
+            return true;
+        }
+        newer = older;
+    }
+
+    // Older than everything we have, use the oldest sample
+    pos = samples[newer].pos;
+    rot = samples[newer].rot;
+    return true;
+}
+
+bool TransformHistory::isEmpty() const
+{
+    return count == 0;
+}
+
+void TransformHistory::clear()
+{
+    head = count = 0;
+}
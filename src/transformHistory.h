@@ -0,0 +1,39 @@
+#ifndef TRANSFORMHISTORY_H
+#define TRANSFORMHISTORY_H
+
+#include "dataType.h"
+
+#define TRANSFORM_HISTORY_SIZE 32 // At a sync every 200ms that's ~6s of history, more than enough to rewind by a RTT
+
+/// Position and rotation of an entity at a given time
+struct Transform
+{
+    float time; ///< timestampNow() when we received it
+    UVector pos;
+    UQuaternion rot;
+};
+
+/// Ring buffer of the last transforms of an entity, filled from the sync.
+/// The samples are stored inline, so recording and querying never allocate.
+class TransformHistory
+{
+public:
+    TransformHistory();
+    /// Records a transform, overwrites the oldest when full.
+    /// The entities only push when they move: if the last sample is older than maxGap, the entity stood still since,
+    /// so the last transform is recorded again maxGap before time and a rewind doesn't slide across the whole wait
+    void push(float time, const UVector& pos, const UQuaternion& rot, float maxGap=0);
+    bool at(float time, UVector& pos, UQuaternion& rot) const; ///< Interpolated transform at this time, clamped to the recorded range. False if empty
+    bool isEmpty() const;
+    void clear();
+
+private:
+    void append(float time, const UVector& pos, const UQuaternion& rot);
+
+private:
+    Transform samples[TRANSFORM_HISTORY_SIZE];
+    int head; // Index of the next sample to write
+    int count; // Number of valid samples
+};
+
+#endif // TRANSFORMHISTORY_H
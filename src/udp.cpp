@@ -12,6 +12,10 @@
 using namespace Settings;
 
 QUdpSocket* udpSocket;
+#ifdef UDP_NULL_SOCKET
+quint64 udpNullDatagrams = 0;
+quint64 udpNullBytes = 0;
+#endif
 
 void restartUdpServer()
 {
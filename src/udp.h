@@ -1,6 +1,8 @@
 #ifndef UDP_H
 #define UDP_H
 
+#include <QtGlobal>
+
 class QUdpSocket;
 
 void udpProcessPendingDatagrams();
@@ -9,4 +11,10 @@ void disconnectUdpPlayers();
 
 extern QUdpSocket* udpSocket;
 
+#ifdef UDP_NULL_SOCKET
+// The benchmarks don't send anything, they only count what would have been sent
+extern quint64 udpNullDatagrams;
+extern quint64 udpNullBytes;
+#endif
+
 #endif // UDP_H
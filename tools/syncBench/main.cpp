@@ -0,0 +1,235 @@
+// Sync scalability benchmark
+// Builds synthetic scenes of fake players and runs Sync::doSync on them with a null socket,
+// then reports the CPU time, datagrams, bytes and allocations per tick.
+//
+// Usage: syncBench [-ticks N] [-scenes N] [-moving percent] [-radius R] [-quantized]
+//   -radius 0 syncs the whole scene (no area of interest), like the server's syncRadius setting
+// The other sync settings are read from data/server.ini, so strategies can be compared by editing it
+
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include "app.h"
+#include "player.h"
+#include "scene.h"
+#include "sync.h"
+#include "settings.h"
+#include "udp.h"
+
+int argc = 0;
+
+QTextStream cout(stdout);
+QTextStream cin(stdin);
+
+QAPP_TYPE a(argc,(char**)0);
+App app;
+
+// Count every allocation made while we measure
+static std::atomic<quint64> nAllocs{0};
+
+void* operator new(std::size_t size)
+{
+    nAllocs++;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+enum Layout
+{
+    Random, // Spread over the whole scene
+    Clustered // Packed around a few hotspots, like a town square
+};
+
+struct BenchConfig
+{
+    int ticks;
+    int nScenes;
+    int movingPercent;
+    bool quantized;
+};
+
+static float randf(float min, float max)
+{
+    return min + (max-min) * (qrand() / (float)RAND_MAX);
+}
+
+static void createScenes(int nPlayers, Layout layout, const BenchConfig& config)
+{
+    const int nClusters = 8;
+    const float area = 1000; // Half size of the populated area
+    UVector clusters[nClusters];
+    for (int i=0; i<nClusters; i++)
+        clusters[i] = UVector(randf(-area, area), 0, randf(-area, area));
+
+    for (int i=0; i<config.nScenes; i++)
+    {
+        Scene scene("bench"+QString().setNum(i));
+        scene.quantizedSync = config.quantized;
+        scene.boundsMin = UVector(XMIN, YMIN, ZMIN);
+        scene.boundsMax = UVector(XMAX, YMAX, ZMAX);
+        scene.id = scene.baseId = Scene::scenes.size();
+        scene.instances << scene.id;
+        Scene::ids.insert(scene.name, scene.id);
+        Scene::scenes << scene;
+    }
+
+    for (int i=0; i<nPlayers; i++)
+    {
+        Scene& scene = Scene::scenes[i % config.nScenes];
+        Player* player = new Player();
+        player->IP = "127.0.0.1";
+        player->port = 10000 + i;
+        player->inGame = 3;
+        player->pony.id = i+1;
+        player->pony.netviewId = i+1;
+        player->pony.sceneId = scene.id;
+        if (layout == Random)
+            player->pony.pos = UVector(randf(-area, area), 0, randf(-area, area));
+        else
+        {
+            const UVector& center = clusters[qrand() % nClusters];
+            player->pony.pos = UVector(center.x + randf(-30, 30), 0, center.z + randf(-30, 30));
+        }
+        player->pony.markSyncDirty();
+        scene.addPlayer(player);
+    }
+}
+
+static void deleteScenes()
+{
+    for (int i=0; i<Scene::scenes.size(); i++)
+        for (Player* player : Scene::scenes[i].players)
+            delete player;
+    Scene::scenes.clear();
+    Scene::ids.clear();
+}
+
+static void movePlayers(int movingPercent)
+{
+    for (int i=0; i<Scene::scenes.size(); i++)
+    {
+        Scene& scene = Scene::scenes[i];
+        for (Player* player : scene.players)
+        {
+            if (qrand() % 100 >= movingPercent)
+                continue;
+            player->pony.pos.x += randf(-2, 2);
+            player->pony.pos.z += randf(-2, 2);
+            player->pony.markSyncDirty();
+            scene.grid.update(player, player->pony.pos);
+        }
+    }
+}
+
+static void runBench(int nPlayers, Layout layout, const BenchConfig& config)
+{
+    qsrand(nPlayers); // Same scene for every strategy we compare
+    createScenes(nPlayers, layout, config);
+    Sync sync;
+
+    // Warm up: the first syncs send everything, and fill the caches
+    for (int i=0; i<3; i++)
+    {
+        movePlayers(config.movingPercent);
+        sync.doSync();
+    }
+
+    udpNullDatagrams = udpNullBytes = 0;
+    quint64 cpuTime = 0, wallTime = 0, allocs = 0;
+    for (int i=0; i<config.ticks; i++)
+    {
+        movePlayers(config.movingPercent);
+
+        QElapsedTimer wall;
+        quint64 allocsBefore = nAllocs;
+        std::clock_t cpuBefore = std::clock(); // Process time, counts the worker threads too
+        wall.start();
+        sync.doSync();
+        wallTime += wall.nsecsElapsed();
+        cpuTime += std::clock() - cpuBefore;
+        allocs += nAllocs - allocsBefore;
+    }
+
+    double cpuUs = cpuTime * 1000000.0 / CLOCKS_PER_SEC / config.ticks;
+    cout << QString("%1 %2 %3 %4 %5 %6 %7")
+            .arg(nPlayers, 6)
+            .arg(layout == Random ? "random" : "clustered", 10)
+            .arg(cpuUs, 12, 'f', 1)
+            .arg(wallTime / 1000.0 / config.ticks, 12, 'f', 1)
+            .arg(udpNullDatagrams / (double)config.ticks, 12, 'f', 1)
+            .arg(udpNullBytes / (double)config.ticks, 12, 'f', 0)
+            .arg(allocs / (double)config.ticks, 12, 'f', 0) << endl;
+
+    deleteScenes();
+}
+
+int main(int argCount, char** argValues)
+{
+    BenchConfig config;
+    config.ticks = 100;
+    config.nScenes = 1;
+    config.movingPercent = 30;
+    config.quantized = false;
+    app.loadConfig(); // Same sync settings as the server, the defaults if there's no config file here
+    Settings::streamRadius = 0; // The fake clients know every entity of their scene
+
+    // The global QCoreApplication is built before main without the arguments, read them here
+    QStringList args;
+    for (int i=0; i<argCount; i++)
+        args << QString::fromLocal8Bit(argValues[i]);
+    for (int i=1; i<args.size(); i++)
+    {
+        bool hasValue = i+1 < args.size();
+        if (args[i] == "-ticks" && hasValue)
+            config.ticks = qMax(1, args[++i].toInt());
+        else if (args[i] == "-scenes" && hasValue)
+            config.nScenes = qMax(1, args[++i].toInt());
+        else if (args[i] == "-moving" && hasValue)
+            config.movingPercent = args[++i].toInt();
+        else if (args[i] == "-radius" && hasValue)
+            Settings::syncRadius = args[++i].toInt();
+        else if (args[i] == "-quantized")
+            config.quantized = true;
+        else
+        {
+            cout << "Usage: syncBench [-ticks N] [-scenes N] [-moving percent] [-radius R] [-quantized]" << endl;
+            return 1;
+        }
+    }
+
+    cout << QString("Sync benchmark: %1 ticks, %2 scenes, %3% moving, radius %4%5")
+            .arg(config.ticks).arg(config.nScenes).arg(config.movingPercent)
+            .arg(Settings::syncRadius).arg(config.quantized ? ", quantized" : "") << endl;
+    cout << QString("%1 %2 %3 %4 %5 %6 %7")
+            .arg("ponies", 6).arg("layout", 10).arg("cpu us/tick", 12).arg("wall us/tick", 12)
+            .arg("dgrams/tick", 12).arg("bytes/tick", 12).arg("allocs/tick", 12) << endl;
+
+    const int playerCounts[] = {10, 50, 100, 250, 500, 1000, 2000};
+    for (int nPlayers : playerCounts)
+    {
+        runBench(nPlayers, Random, config);
+        runBench(nPlayers, Clustered, config);
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# Sync scalability benchmark
+# Drives Sync::doSync on synthetic scenes, with a null socket
+#
+#-------------------------------------------------
+
+TARGET = syncBench
+
+QT       += core network
+QT       += xml
+QT       += concurrent
+QT       -= gui
+TEMPLATE = app
+
+CONFIG   -= app_bundle
+CONFIG   += console
+DEFINES  += USE_CONSOLE
+DEFINES  += UDP_NULL_SOCKET # Count the datagrams instead of sending them
+
+DEFINES += APP_NAME=\\\"$${TARGET}\\\" \
+    APP_VERSION=\\\"0\\\"
+
+SOURCES += main.cpp
+
+include(../../src/server.pri)
+
+macx {
+    QMAKE_LFLAGS += -F /System/Library/Frameworks/CoreServices.framework/
+    LIBS += -framework CoreServices
+}
+
+CONFIG += c++11